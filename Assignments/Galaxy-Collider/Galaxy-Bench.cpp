@@ -0,0 +1,249 @@
+/*
+ *
+MIT License
+
+Copyright (c) 2018 Chris McArthur, prince.chrismc(at)gmail(dot)com
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+
+#include "Simulation.h"
+#include "Gravity.h"
+
+#include "benchmark/benchmark.h"
+#include "tbb/parallel_for.h"
+#include "tbb/task_arena.h"
+
+#include <algorithm>
+#include <map>
+#include <thread>
+#include <vector>
+
+// Every benchmark takes { particles, threads }, the results can be saved with --benchmark_out=FILE and
+// --benchmark_out_format=json|csv to compare releases
+static constexpr const uint64_t SEED = 42;
+
+static void ParticlesAndThreads( benchmark::internal::Benchmark* bench, int64_t max_particles )
+{
+   const int hardware = static_cast<int>( std::max( 1u, std::thread::hardware_concurrency() ) );
+
+   std::vector<int64_t> threads;
+   for( int t = 1; t < hardware; t *= 2 ) threads.push_back( t );
+   threads.push_back( hardware );
+
+   for( int64_t particles = 1 << 10; particles <= max_particles; particles *= 8 )
+      for( int64_t t : threads )
+         bench->Args( { particles, t } );
+
+   bench->ArgNames( { "particles", "threads" } )->Unit( benchmark::kMillisecond )->UseRealTime();
+}
+
+static void UpToAMillion( benchmark::internal::Benchmark* bench ) { ParticlesAndThreads( bench, 1 << 20 ); }
+static void UpToSixtyFourThousand( benchmark::internal::Benchmark* bench ) { ParticlesAndThreads( bench, 1 << 16 ); }
+
+// The two galaxies of the simulation, generated once per size and copied by every benchmark
+static const Universe& GetUniverse( size_t particles )
+{
+   static std::map<size_t, Universe> s_Universes;
+
+   auto it = s_Universes.find( particles );
+   if( it == s_Universes.end() )
+      it = s_Universes.emplace( particles, Simulation( particles, SEED ).GetUniverse() ).first;
+
+   return it->second;
+}
+
+static QuadTree MakeTree()
+{
+   return QuadTree( -Simulation::BOUNDARY, -Simulation::BOUNDARY, 2.0f * Simulation::BOUNDARY );
+}
+
+static void BM_GalaxyBuild( benchmark::State& state )
+{
+   const size_t particles = static_cast<size_t>( state.range( 0 ) );
+   tbb::task_arena arena( static_cast<int>( state.range( 1 ) ) );
+
+   for( auto _ : state )
+   {
+      Universe universe;
+      arena.execute( [ &universe, particles ] { Galaxy::Build( universe, ObjectColors::RED, 0.0f, 0.0f, 0.75f, particles, false, SEED ); } );
+      benchmark::DoNotOptimize( universe.m_X.data() );
+   }
+   state.SetItemsProcessed( state.iterations() * state.range( 0 ) );
+}
+BENCHMARK( BM_GalaxyBuild )->Apply( UpToAMillion );
+
+// Building a tree resolves collisions which merge and move particles, every build starts from the same universe. The
+// copy reuses the columns' storage and is not timed
+static void RestoreUniverse( benchmark::State& state, Universe& universe, const Universe& pristine )
+{
+   state.PauseTiming();
+   universe = pristine;
+   state.ResumeTiming();
+}
+
+// The original insertion with a lock per quadrant
+static void BM_TreeInsert( benchmark::State& state )
+{
+   const Universe& pristine = GetUniverse( static_cast<size_t>( state.range( 0 ) ) );
+   Universe universe = pristine;
+   QuadTree tree = MakeTree();
+   tbb::task_arena arena( static_cast<int>( state.range( 1 ) ) );
+
+   for( auto _ : state )
+   {
+      RestoreUniverse( state, universe, pristine );
+      arena.execute( [ &tree, &universe ] { tree.build( universe, universe.size() ); } );
+   }
+
+   state.SetItemsProcessed( state.iterations() * state.range( 0 ) );
+}
+BENCHMARK( BM_TreeInsert )->Apply( UpToAMillion );
+
+static void BM_TreeMorton( benchmark::State& state )
+{
+   const Universe& pristine = GetUniverse( static_cast<size_t>( state.range( 0 ) ) );
+   Universe universe = pristine;
+   QuadTree tree = MakeTree();
+   tbb::task_arena arena( static_cast<int>( state.range( 1 ) ) );
+
+   for( auto _ : state )
+   {
+      RestoreUniverse( state, universe, pristine );
+      arena.execute( [ &tree, &universe ] { tree.buildMorton( universe, universe.size() ); } );
+   }
+
+   state.SetItemsProcessed( state.iterations() * state.range( 0 ) );
+}
+BENCHMARK( BM_TreeMorton )->Apply( UpToAMillion );
+
+static void BM_MassDistribution( benchmark::State& state )
+{
+   Universe universe = GetUniverse( static_cast<size_t>( state.range( 0 ) ) );
+   QuadTree tree = MakeTree();
+   tbb::task_arena arena( static_cast<int>( state.range( 1 ) ) );
+   arena.execute( [ &tree, &universe ] { tree.buildMorton( universe, universe.size() ); } );
+
+   for( auto _ : state )
+      arena.execute( [ &tree ] { tree.calcMassDistribution(); } );
+
+   state.SetItemsProcessed( state.iterations() * state.range( 0 ) );
+}
+BENCHMARK( BM_MassDistribution )->Apply( UpToAMillion );
+
+// Accelerations of every particle with one of the solvers, the tree is built once
+template<Simulation::Solver SOLVER>
+static void BM_Force( benchmark::State& state )
+{
+   Universe universe = GetUniverse( static_cast<size_t>( state.range( 0 ) ) );
+   const size_t particles = universe.size();
+   const std::vector<uint8_t> active( particles, 1 );
+
+   QuadTree tree = MakeTree();
+   FastMultipole multipole;
+   tbb::task_arena arena( static_cast<int>( state.range( 1 ) ) );
+   arena.execute( [ &tree, &universe ] { tree.buildMorton( universe, universe.size() ); tree.calcMassDistribution(); } );
+
+   for( auto _ : state )
+   {
+      arena.execute( [ &tree, &universe, &multipole, &active, particles ]
+      {
+         switch( SOLVER )
+         {
+         case Simulation::Solver::BARNES_HUT:
+            tbb::parallel_for(
+               tbb::blocked_range<size_t>( 0, particles ),
+               [ &tree, &universe ]( const tbb::blocked_range<size_t>& range )
+               {
+                  for( size_t rank = range.begin(); rank < range.end(); rank++ )
+                  {
+                     const size_t particle = tree.getParticleInTreeOrder( rank );
+                     const glm::vec2 acc = tree.calcForce( particle );
+                     universe.m_AX[ particle ] = acc.x;
+                     universe.m_AY[ particle ] = acc.y;
+                  }
+               }
+            );
+            break;
+         case Simulation::Solver::BARNES_HUT_GROUPS:
+            tree.calcGroupForces( active, universe.m_AX.data(), universe.m_AY.data() );
+            break;
+         case Simulation::Solver::FAST_MULTIPOLE:
+            multipole.calcForces( tree, active, universe.m_AX.data(), universe.m_AY.data() );
+            break;
+         }
+      } );
+      benchmark::ClobberMemory();
+   }
+
+   state.SetItemsProcessed( state.iterations() * state.range( 0 ) );
+   state.counters[ "interactions_per_particle" ] = static_cast<double>( tree.takeInteractions() + multipole.takeInteractions() ) / ( state.iterations() * particles );
+}
+BENCHMARK_TEMPLATE( BM_Force, Simulation::Solver::BARNES_HUT )->Apply( UpToAMillion );
+BENCHMARK_TEMPLATE( BM_Force, Simulation::Solver::BARNES_HUT_GROUPS )->Apply( UpToAMillion );
+BENCHMARK_TEMPLATE( BM_Force, Simulation::Solver::FAST_MULTIPOLE )->Apply( UpToAMillion );
+
+// O( N^2 ) reference for the solvers, with the same kernel
+static void BM_BruteForce( benchmark::State& state )
+{
+   Universe universe = GetUniverse( static_cast<size_t>( state.range( 0 ) ) );
+   const size_t particles = universe.size();
+   tbb::task_arena arena( static_cast<int>( state.range( 1 ) ) );
+
+   for( auto _ : state )
+   {
+      arena.execute( [ &universe, particles ]
+      {
+         tbb::parallel_for(
+            tbb::blocked_range<size_t>( 0, particles ),
+            [ &universe, particles ]( const tbb::blocked_range<size_t>& range )
+            {
+               for( size_t i = range.begin(); i < range.end(); i++ )
+               {
+                  universe.m_AX[ i ] = 0.0f;
+                  universe.m_AY[ i ] = 0.0f;
+                  Gravity::accumulate( universe.m_X[ i ], universe.m_Y[ i ], universe.m_X.data(), universe.m_Y.data(), universe.m_Mass.data(),
+                                       particles, universe.m_AX[ i ], universe.m_AY[ i ] );
+               }
+            }
+         );
+      } );
+      benchmark::ClobberMemory();
+   }
+
+   state.SetItemsProcessed( state.iterations() * state.range( 0 ) );
+}
+BENCHMARK( BM_BruteForce )->Apply( UpToSixtyFourThousand );
+
+static void BM_Step( benchmark::State& state )
+{
+   Simulation simulation( static_cast<size_t>( state.range( 0 ) ), SEED );
+   simulation.SetSolver( Simulation::Solver::BARNES_HUT_GROUPS );
+   tbb::task_arena arena( static_cast<int>( state.range( 1 ) ) );
+
+   for( auto _ : state )
+      arena.execute( [ &simulation ] { simulation.Step(); } );
+
+   state.SetItemsProcessed( state.iterations() * state.range( 0 ) );
+}
+BENCHMARK( BM_Step )->Apply( UpToAMillion );
+
+BENCHMARK_MAIN();
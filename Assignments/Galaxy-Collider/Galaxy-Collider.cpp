@@ -27,18 +27,118 @@ SOFTWARE.
 #include <GL/glew.h>
 #include "Singleton.h"
 #include "AppController.h"
+#include "ParticleModel.h"
+#include "OverlayModel.h"
 
-#include "Galaxy.h"
-#include "Quadrant.h"
-
-#include "tbb/parallel_for_each.h"
-#include "tbb/task_scheduler_init.h"
+#include "Simulation.h"
+#include "TripleBuffer.h"
 
+#include <atomic>
+#include <chrono>
+#include <cstring>
 #include <iostream>
+#include <string>
+#include <thread>
+
+// Steps and draws one after the other, the simulation is bound by the display's refresh rate
+static void RunLockstep( AppController& oController, Simulation& simulation )
+{
+   QuadTree::Overlay overlay;
+
+   oController.Start();
+   while( oController.IsRunning() )
+   {
+      oController.ClearFrame();
+
+      simulation.Step();
+
+      {
+         Profiler::Scope scope( simulation.GetProfiler(), Profiler::RENDER );
+
+         const Universe& universe = simulation.GetUniverse();
+         ParticleModel::GetInstance().Draw( universe.m_X.data(), universe.m_Y.data(), universe.m_Color.data(), universe.size() );
+
+         simulation.CollectOverlay( overlay );
+         OverlayModel::GetInstance().Draw( overlay );
+      }
+
+      if( oController++ )
+         simulation.Print();
+   }
+}
+
+// The simulation steps as fast as it can on its own thread and publishes a copy of the positions after every step, the
+// render loop draws whichever copy is the latest so neither of them waits on the other
+static void RunDecoupled( AppController& oController, Simulation& simulation )
+{
+   TripleBuffer<Simulation::Frame> frames;
+   simulation.Capture( frames.getBack() );
+   frames.publish();
 
+   std::atomic<bool> stepping{ true };
+   std::thread simulationThread( [ &simulation, &frames, &stepping ]
+   {
+      while( stepping.load( std::memory_order_relaxed ) )
+      {
+         simulation.Step();
+         simulation.Capture( frames.getBack() );
+         frames.publish();
+      }
+   } );
+
+   size_t lastStep = 0;
+   auto lastReport = std::chrono::steady_clock::now();
+
+   oController.Start();
+   while( oController.IsRunning() )
+   {
+      oController.ClearFrame();
+
+      frames.acquire();
+      const Simulation::Frame& frame = frames.getFront();
+      {
+         Profiler::Scope scope( simulation.GetProfiler(), Profiler::RENDER );
+         ParticleModel::GetInstance().Draw( frame.m_X.data(), frame.m_Y.data(), frame.m_Color.data(), frame.m_X.size() );
+         OverlayModel::GetInstance().Draw( frame.m_Overlay );
+      }
+
+      if( oController++ )
+      {
+         const auto now = std::chrono::steady_clock::now();
+         const std::chrono::duration<double> elapsed = now - lastReport;
+         std::cout << "Steps/s: " << ( frame.m_Step - lastStep ) / elapsed.count() << " // " << frame.m_X.size()
+                   << " particles drawn at step " << frame.m_Step << std::endl;
+
+         lastStep = frame.m_Step;
+         lastReport = now;
+      }
+   }
+
+   stepping = false;
+   simulationThread.join();
+}
 
 int main( int argc, char** argv )
 {
+   // --decoupled runs the simulation on its own thread, by default it steps once per frame. --overlay DEPTH outlines the
+   // quad tree's cells down to DEPTH levels and --heatmap colors them by how many particles interact with them.
+   // --profile FILE records the phases of the last steps and writes them as CSV ( or JSON for a .json file ) on exit
+   bool decoupled = false;
+   unsigned overlayDepth = 0;
+   bool heatmap = false;
+   std::string profile;
+   for( int i = 1; i < argc; i++ )
+   {
+      if( std::strcmp( argv[ i ], "--decoupled" ) == 0 )
+         decoupled = true;
+      else if( std::strcmp( argv[ i ], "--overlay" ) == 0 && i + 1 < argc )
+         overlayDepth = static_cast<unsigned>( std::stoul( argv[ ++i ] ) );
+      else if( std::strcmp( argv[ i ], "--heatmap" ) == 0 )
+         heatmap = true;
+      else if( std::strcmp( argv[ i ], "--profile" ) == 0 && i + 1 < argc )
+         profile = argv[ ++i ];
+   }
+
    AppController oController;
 
    try
@@ -52,62 +152,20 @@ int main( int argc, char** argv )
       return -1;
    }
 
-   Universe universe;
-   const auto blackholePrime = Galaxy::Build( universe, ObjectColors::RED, 5.0f, -4.0f, 0.75f, 3500 );
-   const auto blackholeSmall = Galaxy::Build( universe, ObjectColors::GREEN, -4.0f, 3.0f, 0.35f, 800 );
-   const size_t NUM_PARTICLES = universe.size() - 1;
-
-   const auto rotateAroundBlackholeFilter = [ blackholePrime, blackholeSmall ]( Particle* particle )
-   {
-      const auto calcForceAroundPrime = Galaxy::GenerateRotationAlgorithm( blackholePrime, false );
-      const auto clacForceAroundSmall = Galaxy::GenerateRotationAlgorithm( blackholeSmall, true );
-
-      // TO DO : Instead of deciding by color pick the closest one!
-      switch( particle->m_Color )
-      {
-      case ObjectColors::RED:
-         calcForceAroundPrime( particle );
-         break;
-      case ObjectColors::GREEN:
-         clacForceAroundSmall( particle );
-         break;
-      default:
-         break; // Skips blackholes!
-      }
-   };
-
-   const auto applyFilterOnUniverse = [ &universe, NUM_PARTICLES ]( const Galaxy::ParticleManipulator& effect )
-   {
-      tbb::parallel_for(
-         tbb::blocked_range<size_t>( 0, NUM_PARTICLES ),
-         [ effect, &universe ]( const tbb::blocked_range<size_t>& range )
-         {
-            for( size_t i = range.begin(); i < range.end(); i++ )
-               effect( &universe.at( i ) );
-         }
-      );
-   };
+   Simulation simulation;
+   simulation.SetOverlay( overlayDepth, heatmap );
+   simulation.GetProfiler().setEnabled( !profile.empty() );
 
    //
    // Render Loop
    //
-   oController.Start();
-   while( oController.IsRunning() )
-   {
-      oController.ClearFrame();
-
-      Quadrant root( Quadrant::ROOT, -42.0f, -42.0f, 42.0f, 42.0f );
-      applyFilterOnUniverse( [ &root ]( Particle* particle ) { root.insert( particle ); } );
-
-      root.Draw();
+   if( decoupled )
+      RunDecoupled( oController, simulation );
+   else
+      RunLockstep( oController, simulation );
 
-      root.calcMassDistribution();
-      applyFilterOnUniverse( rotateAroundBlackholeFilter );
-      applyFilterOnUniverse( [ &root ]( Particle* particle ) { particle->m_Pos += root.calcForce( *particle ); } );
-
-      if( oController++ )
-         root.print();
-   }
+   if( !profile.empty() && !simulation.GetProfiler().exportFile( profile ) )
+      std::cout << "Failed to write the profile to " << profile << std::endl;
 
    return 0;
 }
@@ -0,0 +1,177 @@
+/*
+ *
+MIT License
+
+Copyright (c) 2018 Chris McArthur, prince.chrismc(at)gmail(dot)com
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+
+#include "Simulation.h"
+
+#include "tbb/task_scheduler_init.h"
+
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <optional>
+#include <string>
+
+int main( int argc, char** argv )
+{
+   size_t steps = 1000;
+   size_t particles = Simulation::DEFAULT_PARTICLES;
+   std::optional<Simulation::Solver> solver;   // a restored run keeps the snapshot's settings unless they are given
+   std::optional<float> theta;
+   uint64_t seed = Random::makeSeed();
+   std::optional<float> dt;
+   std::optional<bool> adaptive;
+   int threads = tbb::task_scheduler_init::automatic;
+   std::string profile;
+   std::string checkpoint;
+   size_t every = 100;
+   std::string restore;
+
+   const auto printUsage = [ argv ]()
+   {
+      std::cout << "Usage: " << argv[ 0 ] << " [--steps N] [--particles P] [--solver bh|groups|fmm] [--theta A] [--dt DT] [--adaptive on|off] [--seed S] [--threads T] [--profile FILE.csv|FILE.json] [--checkpoint FILE] [--every K] [--restore FILE]" << std::endl;
+      return -1;
+   };
+
+   for( int i = 1; i < argc; i++ )
+   {
+      if( i + 1 == argc )
+         return printUsage();
+
+      const std::string option = argv[ i ];
+      const std::string value = argv[ ++i ];
+
+      if( option == "--steps" )
+         steps = std::stoul( value );
+      else if( option == "--particles" )
+         particles = std::stoul( value );
+      else if( option == "--solver" && value == "bh" )
+         solver = Simulation::Solver::BARNES_HUT;
+      else if( option == "--solver" && value == "groups" )
+         solver = Simulation::Solver::BARNES_HUT_GROUPS;
+      else if( option == "--solver" && value == "fmm" )
+         solver = Simulation::Solver::FAST_MULTIPOLE;
+      else if( option == "--theta" )
+         theta = std::stof( value );
+      else if( option == "--dt" )
+         dt = std::stof( value );
+      else if( option == "--adaptive" && ( value == "on" || value == "off" ) )
+         adaptive = value == "on";
+      else if( option == "--seed" )
+         seed = std::stoull( value );
+      else if( option == "--threads" )
+         threads = std::stoi( value );
+      else if( option == "--profile" )
+         profile = value;
+      else if( option == "--checkpoint" )
+         checkpoint = value;
+      else if( option == "--every" && std::stoul( value ) > 0 )
+         every = std::stoul( value );
+      else if( option == "--restore" )
+         restore = value;
+      else
+         return printUsage();
+   }
+
+   tbb::task_scheduler_init init( threads );
+
+   std::cout << "Welcome to the headless Galaxy Collider Simulator!" << std::endl << std::endl;
+
+   std::unique_ptr<Simulation> instance;
+   if( restore.empty() )
+      instance = std::make_unique<Simulation>( particles, seed );
+   else
+   {
+      const auto start = std::chrono::steady_clock::now();
+      Snapshot snapshot;
+      if( !snapshot.load( restore ) )
+      {
+         std::cout << "Failed to load the snapshot " << restore << std::endl;
+         return -1;
+      }
+      instance = std::make_unique<Simulation>( std::move( snapshot ) );
+      const std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+      std::cout << "Restored step " << instance->GetSteps() << " from " << restore << " in " << elapsed.count() << " ms" << std::endl;
+   }
+
+   Simulation& simulation = *instance;
+   if( solver ) simulation.SetSolver( *solver );
+   if( theta ) simulation.SetTheta( *theta );
+   if( dt ) simulation.SetTimestep( *dt );
+   if( adaptive ) simulation.SetAdaptive( *adaptive );
+   simulation.GetProfiler().setEnabled( !profile.empty() );
+   std::cout << "Stepping " << simulation.GetUniverse().size() << " particles " << steps << " times with seed " << simulation.GetSeed() << "..." << std::endl;
+
+   // The step only waits on the previous checkpoint if it is still being written
+   SnapshotWriter writer;
+   const size_t evaluations = simulation.GetForceEvaluations();
+   const auto start = std::chrono::steady_clock::now();
+   for( size_t i = 0; i < steps; i++ )
+   {
+      simulation.Step();
+      if( !checkpoint.empty() && ( simulation.GetSteps() % every == 0 || i + 1 == steps ) )
+      {
+         simulation.Save( writer.acquire() );
+         writer.commit( checkpoint );
+      }
+   }
+   const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+   if( !writer.wait() )
+   {
+      std::cout << "Failed to write the checkpoint " << checkpoint << std::endl;
+      return -1;
+   }
+
+   // A restore only run with --steps 0 has no rates to report
+   if( steps > 0 )
+      std::cout << "Steps/s: " << steps / elapsed.count() << " // ";
+   simulation.Print();
+   if( steps > 0 )
+      std::cout << "Force evaluations per particle and step: " << static_cast<double>( simulation.GetForceEvaluations() - evaluations ) / ( steps * simulation.GetNumParticles() ) << std::endl;
+
+   // FNV-1a over the final state, runs with the same seed must match
+   const Universe& universe = simulation.GetUniverse();
+   uint64_t checksum = 14695981039346656037ull;
+   const auto hash = [ &checksum ]( const void* data, size_t bytes )
+   {
+      for( size_t i = 0; i < bytes; i++ )
+         checksum = ( checksum ^ static_cast<const unsigned char*>( data )[ i ] ) * 1099511628211ull;
+   };
+   hash( universe.m_X.data(), universe.size() * sizeof( float ) );
+   hash( universe.m_Y.data(), universe.size() * sizeof( float ) );
+   hash( universe.m_Mass.data(), universe.size() * sizeof( float ) );
+   std::cout << "Checksum: " << std::hex << checksum << std::dec << std::endl;
+
+   if( !profile.empty() && !simulation.GetProfiler().exportFile( profile ) )
+   {
+      std::cout << "Failed to write the profile to " << profile << std::endl;
+      return -1;
+   }
+
+   return 0;
+}
@@ -0,0 +1,274 @@
+/*
+MIT License
+
+Copyright (c) 2018 Chris McArthur, prince.chrismc(at)gmail(dot)com
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+
+#include "Simulation.h"
+#include "Validation.h"
+
+#include "tbb/task_scheduler_init.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace
+{
+   const char* getName( Simulation::Solver solver )
+   {
+      switch( solver )
+      {
+      case Simulation::Solver::BARNES_HUT: return "bh";
+      case Simulation::Solver::BARNES_HUT_GROUPS: return "groups";
+      case Simulation::Solver::FAST_MULTIPOLE: return "fmm";
+      }
+      return "";
+   }
+
+   bool parseSolvers( const std::string& value, std::vector<Simulation::Solver>& solvers )
+   {
+      solvers.clear();
+      std::stringstream list( value );
+      for( std::string name; std::getline( list, name, ',' ); )
+      {
+         if( name == "bh" )
+            solvers.push_back( Simulation::Solver::BARNES_HUT );
+         else if( name == "groups" )
+            solvers.push_back( Simulation::Solver::BARNES_HUT_GROUPS );
+         else if( name == "fmm" )
+            solvers.push_back( Simulation::Solver::FAST_MULTIPOLE );
+         else
+            return false;
+      }
+      return !solvers.empty();
+   }
+
+   bool parseThetas( const std::string& value, std::vector<float>& thetas )
+   {
+      thetas.clear();
+      std::stringstream list( value );
+      for( std::string theta; std::getline( list, theta, ',' ); )
+         thetas.push_back( std::stof( theta ) );
+      return !thetas.empty();
+   }
+
+   // Bit for bit, the accelerations are recomputed by the next step
+   bool isIdentical( const Universe& a, const Universe& b )
+   {
+      const auto same = [ &a, &b ]( const Universe::Column<float>& x, const Universe::Column<float>& y )
+      {
+         return x.size() == y.size() && std::memcmp( x.data(), y.data(), x.size() * sizeof( float ) ) == 0;
+      };
+      return same( a.m_X, b.m_X ) && same( a.m_Y, b.m_Y ) && same( a.m_VX, b.m_VX ) && same( a.m_VY, b.m_VY ) && same( a.m_Mass, b.m_Mass );
+   }
+}
+
+int main( int argc, char** argv )
+{
+   size_t particles = Simulation::DEFAULT_PARTICLES;
+   uint64_t seed = Random::makeSeed();
+   size_t warmup = 0;
+   size_t steps = 100;
+   size_t every = 10;
+   std::vector<Simulation::Solver> solvers = { Simulation::Solver::BARNES_HUT, Simulation::Solver::BARNES_HUT_GROUPS, Simulation::Solver::FAST_MULTIPOLE };
+   std::vector<float> thetas = { QuadTree::DEFAULT_THETA, 0.7f, 0.5f, 0.3f };
+   float dt = Integrator::DEFAULT_TIMESTEP;
+   bool adaptive = false;
+   int threads = tbb::task_scheduler_init::automatic;
+
+   const auto printUsage = [ argv ]()
+   {
+      std::cout << "Usage: " << argv[ 0 ] << " [--particles P] [--seed S] [--warmup N] [--steps N] [--every K] [--solver bh,groups,fmm] [--theta A,B,...] [--dt DT] [--adaptive on|off] [--threads T]" << std::endl;
+      return -1;
+   };
+
+   for( int i = 1; i < argc; i++ )
+   {
+      if( i + 1 == argc )
+         return printUsage();
+
+      const std::string option = argv[ i ];
+      const std::string value = argv[ ++i ];
+
+      if( option == "--particles" )
+         particles = std::stoul( value );
+      else if( option == "--seed" )
+         seed = std::stoull( value );
+      else if( option == "--warmup" )
+         warmup = std::stoul( value );
+      else if( option == "--steps" )
+         steps = std::stoul( value );
+      else if( option == "--every" && std::stoul( value ) > 0 )
+         every = std::stoul( value );
+      else if( option == "--solver" && parseSolvers( value, solvers ) )
+         continue;
+      else if( option == "--theta" && parseThetas( value, thetas ) )
+         continue;
+      else if( option == "--dt" )
+         dt = std::stof( value );
+      else if( option == "--adaptive" && ( value == "on" || value == "off" ) )
+         adaptive = value == "on";
+      else if( option == "--threads" )
+         threads = std::stoi( value );
+      else
+         return printUsage();
+   }
+
+   tbb::task_scheduler_init init( threads );
+
+   std::cout << "Welcome to the Galaxy Collider validation!" << std::endl << std::endl;
+
+   // Every configuration starts from the same seed and warm up, the tree update may resolve collisions so each one gets
+   // its own simulation and the reference is summed at the positions the solver saw
+   const auto makeSimulation = [ & ]( Simulation::Solver solver, float theta )
+   {
+      auto simulation = std::make_unique<Simulation>( particles, seed );
+      simulation->SetSolver( solver );
+      simulation->SetTheta( theta );
+      simulation->SetTimestep( dt );
+      simulation->SetAdaptive( adaptive );
+      for( size_t i = 0; i < warmup; i++ )
+         simulation->Step();
+      return simulation;
+   };
+
+   std::cout << "Force error relative to direct summation after " << warmup << " steps with seed " << seed << std::endl;
+   std::cout << std::setw( 8 ) << "solver" << std::setw( 8 ) << "theta" << std::setw( 14 ) << "rms" << std::setw( 14 ) << "median"
+             << std::setw( 14 ) << "p99" << std::setw( 14 ) << "max" << std::setw( 12 ) << "solver ms" << std::setw( 12 ) << "direct ms" << std::endl;
+
+   for( Simulation::Solver solver : solvers )
+   {
+      for( float theta : thetas )
+      {
+         // The FMM's separation criterion is fixed, the opening angle only applies to the tree walks
+         const bool multipole = solver == Simulation::Solver::FAST_MULTIPOLE;
+         if( multipole && theta != thetas.front() )
+            continue;
+
+         auto simulation = makeSimulation( solver, theta );
+
+         const auto start = std::chrono::steady_clock::now();
+         simulation->CalcAccelerations();
+         const auto solved = std::chrono::steady_clock::now();
+
+         const Universe& universe = simulation->GetUniverse();
+         const size_t count = simulation->GetNumParticles();
+         Universe::Column<float> exact_x( count );
+         Universe::Column<float> exact_y( count );
+         Validation::calcDirectAccelerations( universe, count, exact_x.data(), exact_y.data() );
+         const auto summed = std::chrono::steady_clock::now();
+
+         const Validation::ForceError error = Validation::calcForceError( universe.m_AX.data(), universe.m_AY.data(), exact_x.data(), exact_y.data(), count );
+         const std::chrono::duration<double, std::milli> solverTime = solved - start;
+         const std::chrono::duration<double, std::milli> directTime = summed - solved;
+
+         std::cout << std::setw( 8 ) << getName( solver ) << std::setw( 8 ) << ( multipole ? "-" : std::to_string( theta ).substr( 0, 4 ) ) << std::scientific << std::setprecision( 3 )
+                   << std::setw( 14 ) << error.m_RMS << std::setw( 14 ) << error.m_Median << std::setw( 14 ) << error.m_P99 << std::setw( 14 ) << error.m_Max
+                   << std::fixed << std::setprecision( 2 ) << std::setw( 12 ) << solverTime.count() << std::setw( 12 ) << directTime.count()
+                   << std::defaultfloat << std::setprecision( 6 ) << std::endl;
+      }
+   }
+
+   // Collisions exchange mass and fling particles away so a colliding run does not conserve these exactly either
+   auto simulation = makeSimulation( solvers.front(), thetas.front() );
+   const Validation::Invariants initial = Validation::calcInvariants( simulation->GetUniverse(), simulation->GetNumParticles() );
+
+   std::cout << std::endl << "Drift over " << steps << " steps with " << getName( solvers.front() ) << " at theta " << thetas.front()
+             << ", dt " << dt << ( adaptive ? " adaptive" : "" ) << std::endl;
+   std::cout << std::setw( 8 ) << "step" << std::setw( 14 ) << "energy" << std::setw( 14 ) << "dE / |E0|" << std::setw( 14 ) << "|dP| / sum mv"
+             << std::setw( 14 ) << "dL / |L0|" << std::setw( 14 ) << "dM / M0" << std::endl;
+
+   for( size_t step = 0; step <= steps; step++ )
+   {
+      if( step > 0 )
+         simulation->Step();
+      if( step % every != 0 && step != steps )
+         continue;
+
+      const Validation::Invariants now = Validation::calcInvariants( simulation->GetUniverse(), simulation->GetNumParticles() );
+      const glm::dvec2 momentum = now.m_Momentum - initial.m_Momentum;
+
+      std::cout << std::setw( 8 ) << step << std::scientific << std::setprecision( 3 )
+                << std::setw( 14 ) << now.getEnergy()
+                << std::setw( 14 ) << ( now.getEnergy() - initial.getEnergy() ) / std::abs( initial.getEnergy() )
+                << std::setw( 14 ) << std::sqrt( momentum.x * momentum.x + momentum.y * momentum.y ) / initial.m_AbsMomentum
+                << std::setw( 14 ) << ( now.m_AngularMomentum - initial.m_AngularMomentum ) / std::abs( initial.m_AngularMomentum )
+                << std::setw( 14 ) << ( now.m_Mass - initial.m_Mass ) / initial.m_Mass
+                << std::defaultfloat << std::setprecision( 6 ) << std::endl;
+   }
+
+   // Saving must leave the run alone and a run resumed from the file must continue it bit for bit
+   const size_t resume = steps / 2;
+   const std::string path = "galaxy-validate-" + std::to_string( seed ) + ".snap";
+   bool identical = true;
+
+   std::cout << std::endl << "Checkpoints every " << every << " steps, resumed from step " << resume << " of " << steps << std::endl;
+   for( Simulation::Solver solver : solvers )
+   {
+      auto plain = makeSimulation( solver, thetas.front() );
+      auto saved = makeSimulation( solver, thetas.front() );
+      std::unique_ptr<Simulation> resumed;
+      Snapshot snapshot;
+
+      for( size_t step = 0; step <= steps; step++ )
+      {
+         if( step > 0 )
+         {
+            plain->Step();
+            saved->Step();
+            if( resumed ) resumed->Step();
+            if( step % every == 0 ) saved->Save( snapshot );
+         }
+         if( step != resume )
+            continue;
+
+         saved->Save( snapshot );
+         Snapshot loaded;
+         if( !snapshot.write( path ) || !loaded.load( path ) )
+         {
+            std::cout << "Failed to write and load the snapshot " << path << std::endl;
+            std::remove( path.c_str() );
+            return -1;
+         }
+         resumed = std::make_unique<Simulation>( std::move( loaded ) );
+      }
+
+      const bool savedMatches = isIdentical( plain->GetUniverse(), saved->GetUniverse() );
+      const bool resumedMatches = isIdentical( plain->GetUniverse(), resumed->GetUniverse() );
+      identical = identical && savedMatches && resumedMatches;
+      std::cout << std::setw( 8 ) << getName( solver ) << "   saved " << ( savedMatches ? "identical" : "DIFFERS" ) << ", resumed "
+                << ( resumedMatches ? "identical" : "DIFFERS" ) << std::endl;
+   }
+   std::remove( path.c_str() );
+
+   return identical ? 0 : 1;
+}
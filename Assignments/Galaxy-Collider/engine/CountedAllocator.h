@@ -0,0 +1,59 @@
+/*
+MIT License
+
+Copyright (c) 2018 Chris McArthur, prince.chrismc(at)gmail(dot)com
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+#pragma once
+
+#include "tbb/cache_aligned_allocator.h"
+#include <cstddef>
+
+namespace Allocations
+{
+   // Adds one to the allocations the profiler reports, does nothing unless built with GALAXY_COLLIDER_COUNT_ALLOCATIONS
+   void count();
+}
+
+// tbb::cache_aligned_allocator which reports its allocations, the engine's columns and TBB containers use it since they
+// do not go through operator new
+template<typename T>
+class CountedAllocator : public tbb::cache_aligned_allocator<T>
+{
+public:
+   template<typename U> struct rebind { using other = CountedAllocator<U>; };
+
+   CountedAllocator() = default;
+   template<typename U> CountedAllocator( const CountedAllocator<U>& ) noexcept {}
+
+   T* allocate( std::size_t n )
+   {
+      Allocations::count();
+      return tbb::cache_aligned_allocator<T>::allocate( n );
+   }
+};
+
+template<typename T, typename U>
+bool operator==( const CountedAllocator<T>&, const CountedAllocator<U>& ) { return true; }
+
+template<typename T, typename U>
+bool operator!=( const CountedAllocator<T>&, const CountedAllocator<U>& ) { return false; }
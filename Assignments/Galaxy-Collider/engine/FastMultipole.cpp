@@ -0,0 +1,376 @@
+/*
+MIT License
+
+Copyright (c) 2018 Chris McArthur, prince.chrismc(at)gmail(dot)com
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+#include "FastMultipole.h"
+#include "Gravity.h"
+#include "tbb/parallel_for.h"
+#include "tbb/task_group.h"
+#include "glm/geometric.hpp"
+#include <algorithm>
+#include <cmath>
+
+const FastMultipole::Terms FastMultipole::s_Terms;
+
+FastMultipole::Terms::Terms()
+{
+   int term = 0;
+   for( int n = 0; n <= ORDER; n++ )
+   {
+      for( int a = n; a >= 0; a-- )
+      {
+         m_A[ term ] = a;
+         m_B[ term ] = n - a;
+         m_Index[ a ][ n - a ] = term++;
+      }
+   }
+
+   for( int n = 0; n <= ORDER; n++ )
+   {
+      m_Binomial[ n ][ 0 ] = 1.0;
+      for( int k = 1; k <= ORDER; k++ )
+         m_Binomial[ n ][ k ] = k > n ? 0.0 : m_Binomial[ n ][ k - 1 ] * ( n - k + 1 ) / k;
+   }
+
+   // L_n += sum over k of ( -1 )^|k| C( k + n, n ) M_k D^( k + n ) ( 1 / r ) / ( k + n )!
+   int translation = 0;
+   for( int n = 0; n < TERMS; n++ )
+   {
+      for( int k = 0; k < TERMS; k++ )
+      {
+         const int na = m_A[ n ], nb = m_B[ n ], ka = m_A[ k ], kb = m_B[ k ];
+         if( na + nb + ka + kb > ORDER ) continue;
+
+         const double sign = ( ka + kb ) % 2 == 0 ? 1.0 : -1.0;
+         m_MultipoleToLocal[ translation++ ] = { n, k, m_Index[ ka + na ][ kb + nb ], sign * m_Binomial[ ka + na ][ na ] * m_Binomial[ kb + nb ][ nb ] };
+      }
+   }
+}
+
+void FastMultipole::calcForces( const QuadTree& tree, const std::vector<uint8_t>& active, float* acc_x, float* acc_y )
+{
+   m_Tree = &tree;
+   m_Active = &active;
+
+   if( tree.m_Nodes.empty() || tree.m_Nodes[ QuadTree::ROOT ].m_TotalParticles == 0 )
+      return;
+
+   const size_t nodes = tree.m_Nodes.size(), bodies = tree.m_BodyX.size();
+   m_Multipoles.resize( nodes );
+   m_Radii.resize( nodes );
+   m_Offset.resize( nodes );
+   m_Count.resize( nodes );
+   m_ActiveCount.resize( nodes );
+   m_Locals.assign( nodes, Expansion{} );
+
+   m_BodyX.resize( bodies );
+   m_BodyY.resize( bodies );
+   m_BodyMass.resize( bodies );
+   m_Rank.resize( bodies );
+   m_BodyActive.resize( bodies );
+   m_Gathered = 0;
+   m_AccX.assign( bodies, 0.0f );
+   m_AccY.assign( bodies, 0.0f );
+
+   upwardPass( QuadTree::ROOT );
+   interact( QuadTree::ROOT, QuadTree::ROOT );
+
+   tbb::task_group g;
+   g.run( [ this, acc_x, acc_y ] { downwardPass( QuadTree::ROOT, acc_x, acc_y ); } );
+
+   // Anything outside of the tree falls back to the Barnes-Hut walk
+   tbb::parallel_for(
+      tbb::blocked_range<size_t>( 0, tree.m_Dropped.size() ),
+      [ &tree, &active, acc_x, acc_y ]( const tbb::blocked_range<size_t>& range )
+      {
+         for( size_t i = range.begin(); i < range.end(); i++ )
+         {
+            const int particle = tree.m_Dropped[ i ];
+            if( !active[ particle ] ) continue;
+
+            const glm::vec2 acc = tree.calcForce( particle );
+            acc_x[ particle ] = acc.x;
+            acc_y[ particle ] = acc.y;
+         }
+      }
+   );
+   g.wait();
+}
+
+size_t FastMultipole::takeInteractions()
+{
+   size_t interactions = 0;
+   for( size_t& local : m_Interactions )
+   {
+      interactions += local;
+      local = 0;
+   }
+   return interactions;
+}
+
+void FastMultipole::upwardPass( int index )
+{
+   const QuadTree::Node& node = m_Tree->m_Nodes[ index ];
+   const glm::dvec2 center = getCenter( index );
+   Expansion& multipole = m_Multipoles[ index ];
+   multipole.fill( 0.0 );
+   double& radius = m_Radii[ index ];
+   radius = 0.0;
+
+   Expansion powers;
+   if( isLeaf( node ) )
+   {
+      m_Count[ index ] = 0;
+      m_ActiveCount[ index ] = 0;
+      gather( index, index );
+
+      for( int body = m_Offset[ index ]; body < m_Offset[ index ] + m_Count[ index ]; body++ )
+      {
+         const glm::dvec2 d = glm::dvec2{ m_BodyX[ body ], m_BodyY[ body ] } - center;
+         radius = std::max( radius, glm::length( d ) );
+
+         calcPowers( d, powers );
+         for( int k = 0; k < TERMS; k++ )
+            multipole[ k ] += m_BodyMass[ body ] * powers[ k ];
+      }
+      return;
+   }
+
+   tbb::task_group g;
+   for( int child = node.m_FirstChild; child < node.m_FirstChild + 4; child++ )
+   {
+      if( m_Tree->m_Nodes[ child ].m_TotalParticles == 0 ) continue;
+
+      if( node.m_TotalParticles > GRAIN_SIZE )
+         g.run( [ this, child ] { upwardPass( child ); } );
+      else
+         upwardPass( child );
+   }
+   g.wait();
+
+   m_ActiveCount[ index ] = 0;
+   for( int child = node.m_FirstChild; child < node.m_FirstChild + 4; child++ )
+      if( m_Tree->m_Nodes[ child ].m_TotalParticles > 0 )
+         m_ActiveCount[ index ] += m_ActiveCount[ child ];
+
+   // M2M: ( x - parent )^k = sum over j <= k of C( k, j ) ( x - child )^j ( child - parent )^( k - j )
+   for( int child = node.m_FirstChild; child < node.m_FirstChild + 4; child++ )
+   {
+      if( m_Tree->m_Nodes[ child ].m_TotalParticles == 0 ) continue;
+
+      const glm::dvec2 d = getCenter( child ) - center;
+      radius = std::max( radius, glm::length( d ) + m_Radii[ child ] );
+
+      calcPowers( d, powers );
+      const Expansion& source = m_Multipoles[ child ];
+      for( int k = 0; k < TERMS; k++ )
+      {
+         const int ka = s_Terms.m_A[ k ], kb = s_Terms.m_B[ k ];
+         for( int ja = 0; ja <= ka; ja++ )
+            for( int jb = 0; jb <= kb; jb++ )
+               multipole[ k ] += s_Terms.m_Binomial[ ka ][ ja ] * s_Terms.m_Binomial[ kb ][ jb ] *
+                                 powers[ s_Terms.m_Index[ ka - ja ][ kb - jb ] ] * source[ s_Terms.m_Index[ ja ][ jb ] ];
+      }
+   }
+}
+
+void FastMultipole::gather( int index, int leaf )
+{
+   const QuadTree::Node& node = m_Tree->m_Nodes[ index ];
+   if( index == leaf )
+   {
+      // The subtree's particle count is an upper bound, whatever is left over stays unused
+      m_Offset[ leaf ] = m_Gathered.fetch_add( static_cast<int>( node.m_TotalParticles ) );
+   }
+
+   if( !node.isLeaf() )
+   {
+      for( int child = node.m_FirstChild; child < node.m_FirstChild + 4; child++ )
+         if( m_Tree->m_Nodes[ child ].m_TotalParticles > 0 )
+            gather( child, leaf );
+      return;
+   }
+
+   for( int body = node.m_Body; body < node.m_Body + static_cast<int>( node.m_TotalParticles ); body++ )
+   {
+      const int slot = m_Offset[ leaf ] + m_Count[ leaf ]++;
+      m_BodyX[ slot ] = m_Tree->m_BodyX[ body ];
+      m_BodyY[ slot ] = m_Tree->m_BodyY[ body ];
+      m_BodyMass[ slot ] = m_Tree->m_BodyMass[ body ];
+      m_Rank[ slot ] = body;
+      m_BodyActive[ slot ] = ( *m_Active )[ m_Tree->getParticleInTreeOrder( body ) ];
+      m_ActiveCount[ leaf ] += m_BodyActive[ slot ];
+   }
+}
+
+void FastMultipole::interact( int target, int source )
+{
+   if( m_ActiveCount[ target ] == 0 ) return;
+
+   const QuadTree::Node& a = m_Tree->m_Nodes[ target ];
+   const QuadTree::Node& b = m_Tree->m_Nodes[ source ];
+
+   const glm::dvec2 r = getCenter( target ) - getCenter( source );
+   if( m_Radii[ target ] + m_Radii[ source ] < THETA * glm::length( r ) )
+   {
+      // M2L
+      Expansion derivatives;
+      calcDerivatives( r, derivatives );
+
+      const Expansion& multipole = m_Multipoles[ source ];
+      Expansion& local = m_Locals[ target ];
+      for( const auto& translation : s_Terms.m_MultipoleToLocal )
+         local[ translation.m_N ] += translation.m_Coefficient * multipole[ translation.m_K ] * derivatives[ translation.m_Derivative ];
+
+      m_Interactions.local() += m_ActiveCount[ target ];
+   }
+   else if( isLeaf( a ) && isLeaf( b ) )
+   {
+      // P2P
+      for( int body = m_Offset[ target ]; body < m_Offset[ target ] + m_Count[ target ]; body++ )
+         if( m_BodyActive[ body ] )
+            Gravity::accumulate( m_BodyX[ body ], m_BodyY[ body ],
+                                 &m_BodyX[ m_Offset[ source ] ], &m_BodyY[ m_Offset[ source ] ], &m_BodyMass[ m_Offset[ source ] ],
+                                 m_Count[ source ], m_AccX[ body ], m_AccY[ body ] );
+
+      m_Interactions.local() += static_cast<size_t>( m_ActiveCount[ target ] ) * m_Count[ source ];
+   }
+   else if( isLeaf( a ) || ( !isLeaf( b ) && b.m_Size > a.m_Size ) )
+   {
+      // Only the target's local expansion is written to so the source can be split within this task
+      for( int child = b.m_FirstChild; child < b.m_FirstChild + 4; child++ )
+         if( m_Tree->m_Nodes[ child ].m_TotalParticles > 0 )
+            interact( target, child );
+   }
+   else if( a.m_TotalParticles > GRAIN_SIZE )
+   {
+      tbb::task_group g;
+      for( int child = a.m_FirstChild; child < a.m_FirstChild + 4; child++ )
+         if( m_Tree->m_Nodes[ child ].m_TotalParticles > 0 )
+            g.run( [ this, child, source ] { interact( child, source ); } );
+      g.wait();
+   }
+   else
+   {
+      for( int child = a.m_FirstChild; child < a.m_FirstChild + 4; child++ )
+         if( m_Tree->m_Nodes[ child ].m_TotalParticles > 0 )
+            interact( child, source );
+   }
+}
+
+void FastMultipole::downwardPass( int index, float* acc_x, float* acc_y )
+{
+   const QuadTree::Node& node = m_Tree->m_Nodes[ index ];
+   const glm::dvec2 center = getCenter( index );
+   const Expansion& local = m_Locals[ index ];
+
+   Expansion powers;
+   if( isLeaf( node ) )
+   {
+      // L2P: the acceleration is GAMMA times the gradient of the potential sum of m / r
+      for( int body = m_Offset[ index ]; body < m_Offset[ index ] + m_Count[ index ]; body++ )
+      {
+         if( !m_BodyActive[ body ] ) continue;
+
+         calcPowers( glm::dvec2{ m_BodyX[ body ], m_BodyY[ body ] } - center, powers );
+
+         glm::dvec2 gradient{ 0.0, 0.0 };
+         for( int n = 1; n < TERMS; n++ )
+         {
+            const int na = s_Terms.m_A[ n ], nb = s_Terms.m_B[ n ];
+            if( na > 0 ) gradient.x += local[ n ] * na * powers[ s_Terms.m_Index[ na - 1 ][ nb ] ];
+            if( nb > 0 ) gradient.y += local[ n ] * nb * powers[ s_Terms.m_Index[ na ][ nb - 1 ] ];
+         }
+
+         const size_t particle = m_Tree->getParticleInTreeOrder( m_Rank[ body ] );
+         acc_x[ particle ] = m_AccX[ body ] + static_cast<float>( Gravity::GAMMA * gradient.x );
+         acc_y[ particle ] = m_AccY[ body ] + static_cast<float>( Gravity::GAMMA * gradient.y );
+      }
+      return;
+   }
+
+   tbb::task_group g;
+   for( int child = node.m_FirstChild; child < node.m_FirstChild + 4; child++ )
+   {
+      if( m_Tree->m_Nodes[ child ].m_TotalParticles == 0 || m_ActiveCount[ child ] == 0 ) continue;
+
+      // L2L: L'_j += sum over n >= j of C( n, j ) ( child - parent )^( n - j ) L_n
+      calcPowers( getCenter( child ) - center, powers );
+      Expansion& shifted = m_Locals[ child ];
+      for( int j = 0; j < TERMS; j++ )
+      {
+         const int ja = s_Terms.m_A[ j ], jb = s_Terms.m_B[ j ];
+         for( int n = j; n < TERMS; n++ )
+         {
+            const int na = s_Terms.m_A[ n ], nb = s_Terms.m_B[ n ];
+            if( na < ja || nb < jb ) continue;
+
+            shifted[ j ] += s_Terms.m_Binomial[ na ][ ja ] * s_Terms.m_Binomial[ nb ][ jb ] * powers[ s_Terms.m_Index[ na - ja ][ nb - jb ] ] * local[ n ];
+         }
+      }
+
+      if( node.m_TotalParticles > GRAIN_SIZE )
+         g.run( [ this, child, acc_x, acc_y ] { downwardPass( child, acc_x, acc_y ); } );
+      else
+         downwardPass( child, acc_x, acc_y );
+   }
+   g.wait();
+}
+
+glm::dvec2 FastMultipole::getCenter( int index ) const
+{
+   const QuadTree::Node& node = m_Tree->m_Nodes[ index ];
+   return { node.m_MinX + node.m_Size / 2.0, node.m_MinY + node.m_Size / 2.0 };
+}
+
+void FastMultipole::calcPowers( const glm::dvec2& d, Expansion& out )
+{
+   out[ 0 ] = 1.0;
+   for( int t = 1; t < TERMS; t++ )
+   {
+      const int a = s_Terms.m_A[ t ], b = s_Terms.m_B[ t ];
+      out[ t ] = a > 0 ? out[ s_Terms.m_Index[ a - 1 ][ b ] ] * d.x : out[ s_Terms.m_Index[ a ][ b - 1 ] ] * d.y;
+   }
+}
+
+void FastMultipole::calcDerivatives( const glm::dvec2& r, Expansion& out )
+{
+   // Taylor coefficients D^k ( 1 / r ) / k! from the recurrence
+   // n r^2 b_k = -( 2n - 1 ) sum_i r_i b_( k - e_i ) - ( n - 1 ) sum_i b_( k - 2 e_i )
+   const double r2 = glm::dot( r, r );
+   out[ 0 ] = 1.0 / std::sqrt( r2 );
+
+   for( int t = 1; t < TERMS; t++ )
+   {
+      const int a = s_Terms.m_A[ t ], b = s_Terms.m_B[ t ], n = a + b;
+
+      double first = 0.0, second = 0.0;
+      if( a > 0 ) first += r.x * out[ s_Terms.m_Index[ a - 1 ][ b ] ];
+      if( b > 0 ) first += r.y * out[ s_Terms.m_Index[ a ][ b - 1 ] ];
+      if( a > 1 ) second += out[ s_Terms.m_Index[ a - 2 ][ b ] ];
+      if( b > 1 ) second += out[ s_Terms.m_Index[ a ][ b - 2 ] ];
+
+      out[ t ] = ( -( 2.0 * n - 1.0 ) * first - ( n - 1.0 ) * second ) / ( n * r2 );
+   }
+}
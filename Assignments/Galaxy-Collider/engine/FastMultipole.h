@@ -0,0 +1,108 @@
+/*
+MIT License
+
+Copyright (c) 2018 Chris McArthur, prince.chrismc(at)gmail(dot)com
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+#pragma once
+
+#include "QuadTree.h"
+#include "tbb/enumerable_thread_specific.h"
+#include <array>
+#include <atomic>
+
+// Cartesian Fast Multipole Method on top of the QuadTree's nodes, expansions of the 1 / r potential are truncated at ORDER
+class FastMultipole
+{
+public:
+   // Only the particles flagged in `active` receive a force, the others are still sources. The accelerations are stored
+   // by particle index
+   void calcForces( const QuadTree& tree, const std::vector<uint8_t>& active, float* acc_x, float* acc_y );
+
+   // Expansions and bodies the active particles interacted with since the last call, an M2L counts once for every
+   // active particle below the target
+   size_t takeInteractions();
+
+   static constexpr const int ORDER = 4;
+   static constexpr const int TERMS = ( ORDER + 1 ) * ( ORDER + 2 ) / 2;
+
+   using Expansion = std::array<double, TERMS>;
+
+private:
+   const QuadTree* m_Tree{ nullptr };
+   const std::vector<uint8_t>* m_Active{ nullptr };
+
+   // Indexed like the tree's nodes, only the nodes down to the FMM leaves are used
+   std::vector<Expansion> m_Multipoles;
+   std::vector<Expansion> m_Locals;
+   std::vector<double> m_Radii;     // furthest body from the center
+   std::vector<int> m_Offset;       // first gathered body of an FMM leaf
+   std::vector<int> m_Count;
+   std::vector<unsigned> m_ActiveCount;   // active particles in the subtree, the others need no local expansion
+
+   // Bodies gathered so every FMM leaf is contiguous
+   Universe::Column<float> m_BodyX;
+   Universe::Column<float> m_BodyY;
+   Universe::Column<float> m_BodyMass;
+   std::vector<int> m_Rank;         // position in the tree's body order
+   std::vector<uint8_t> m_BodyActive;
+   std::atomic<int> m_Gathered{ 0 };
+   tbb::enumerable_thread_specific<size_t, CountedAllocator<size_t>> m_Interactions;
+
+   // Near field accelerations in gathered order
+   Universe::Column<float> m_AccX;
+   Universe::Column<float> m_AccY;
+
+   static constexpr const double THETA = 0.5;
+   static constexpr const unsigned GRAIN_SIZE = 2048;
+   static constexpr const unsigned LEAF_PARTICLES = 64;   // subtrees this small are evaluated directly
+
+   bool isLeaf( const QuadTree::Node& node ) const { return node.isLeaf() || node.m_TotalParticles <= LEAF_PARTICLES; }
+   void gather( int node, int leaf );
+
+   void upwardPass( int node );                 // P2M and M2M
+   void interact( int target, int source );     // M2L or P2P, dual tree traversal
+   void downwardPass( int node, float* acc_x, float* acc_y ); // L2L and L2P
+
+   glm::dvec2 getCenter( int node ) const;
+
+   // Multi-indices { a, b } for x^a y^b ordered by a + b
+   struct Terms
+   {
+      Terms();
+
+      std::array<int, TERMS> m_A;
+      std::array<int, TERMS> m_B;
+      std::array<std::array<int, ORDER + 1>, ORDER + 1> m_Index;
+      std::array<std::array<double, ORDER + 1>, ORDER + 1> m_Binomial;
+
+      // Every M2L contribution local[ n ] += coefficient * multipole[ k ] * derivatives[ n + k ] with | n + k | <= ORDER
+      static constexpr const int TRANSLATIONS = ( ORDER + 1 ) * ( ORDER + 2 ) * ( ORDER + 3 ) * ( ORDER + 4 ) / 24;
+
+      struct Translation { int m_N; int m_K; int m_Derivative; double m_Coefficient; };
+      std::array<Translation, TRANSLATIONS> m_MultipoleToLocal;
+   };
+   static const Terms s_Terms;
+
+   static void calcPowers( const glm::dvec2& d, Expansion& out );
+   static void calcDerivatives( const glm::dvec2& r, Expansion& out );
+};
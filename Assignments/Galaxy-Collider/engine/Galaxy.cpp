@@ -0,0 +1,100 @@
+/*
+MIT License
+
+Copyright (c) 2018 Chris McArthur, prince.chrismc(at)gmail(dot)com
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifdef _CLANG
+   #define TBB_USE_GLIBCXX_VERSION 60000 // Know TBBB Issue for linux && clang
+#endif
+
+#include "Galaxy.h"
+#include "Gravity.h"
+#include "Random.h"
+#include "tbb/parallel_for.h"
+#include "tbb/parallel_sort.h"
+#include <utility>
+#include <vector>
+
+size_t Galaxy::Build( Universe& out_particles, ObjectColors col, float x, float y, float radius, size_t particles, bool clockwise, uint64_t seed )
+{
+   const size_t blackhole = out_particles.add( ObjectColors::YELLOW, x, y, BLACKHOLE_MASS );
+   const size_t first = out_particles.grow( particles );
+   static constexpr const long double PI = 3.141592653589793238462643383279502884L;
+
+   const auto ParticleGenerator = [ & ]( const tbb::blocked_range<size_t>& range )
+   {
+      for( size_t i = range.begin(); i < range.end(); i++ )
+      {
+         Random::Stream gen( seed, first + i );
+
+         float rel_x, rel_y;
+         do
+         {
+            const auto a = static_cast<float>( gen.lognormal( 0.0, 1.8645 ) * 2.0L * PI );
+            const auto r = static_cast<float>( sqrt( gen.lognormal( 0.0, 1.8645 ) * radius ) );
+
+            // in Cartesian coordinates
+            rel_x = r * cos( a );
+            rel_y = r * sin( a );
+         } while( sqrt( rel_x * rel_x + rel_y * rel_y ) >= radius * 4.8746f ); // distance in parsec by pythag
+
+         out_particles.m_X[ first + i ] = rel_x + x;
+         out_particles.m_Y[ first + i ] = rel_y + y;
+         out_particles.m_Mass[ first + i ] = 0.76f + static_cast<float>( gen.lognormal( 0.0, 1.0 ) ) / 100.0f;
+         out_particles.m_Color[ first + i ] = col;
+      }
+   };
+
+   tbb::parallel_for( tbb::blocked_range<size_t>( 0, particles ), ParticleGenerator );
+
+   // The orbital speed only depends on the mass closer to the center, visiting the stars from the inside out accumulates it
+   std::vector<std::pair<float, size_t>> byDistance( particles );
+   tbb::parallel_for(
+      tbb::blocked_range<size_t>( 0, particles ),
+      [ & ]( const tbb::blocked_range<size_t>& range )
+      {
+         for( size_t i = range.begin(); i < range.end(); i++ )
+         {
+            const glm::vec2 rel = out_particles.getPos( first + i ) - glm::vec2{ x, y };
+            byDistance[ i ] = { rel.x * rel.x + rel.y * rel.y, first + i };
+         }
+      }
+   );
+   tbb::parallel_sort( byDistance.begin(), byDistance.end() );
+
+   float enclosed = BLACKHOLE_MASS;
+   for( const auto& star : byDistance )
+   {
+      const glm::vec2 rel = out_particles.getPos( star.second ) - glm::vec2{ x, y };
+      const float dist = sqrt( star.first );
+
+      // Circular speed under the softened force law, pointing along the orbit
+      const float r2 = star.first + Gravity::SOFTENING2;
+      const float v = sqrt( Gravity::GAMMA * enclosed * star.first / ( r2 * sqrt( r2 ) ) );
+      const glm::vec2 tangent = clockwise ? glm::vec2{ -rel.y, rel.x } : glm::vec2{ rel.y, -rel.x };
+      out_particles.setVel( star.second, dist > 0.0f ? tangent * ( v / dist ) : glm::vec2{ 0.0f, 0.0f } );
+
+      enclosed += out_particles.m_Mass[ star.second ];
+   }
+
+   return blackhole;
+}
@@ -24,25 +24,15 @@ SOFTWARE.
 
 #pragma once
 
-#include "Particle.h"
+#include "Universe.h"
 #include "ObjectColors.h"
-#include "tbb/concurrent_vector.h"
-#include <functional>
-
-class Blackhole final : public Particle
-{
-public:
-   Blackhole( float x, float y );
-};
-
-using Universe = tbb::concurrent_vector<Particle>;
+#include <cstdint>
 
 namespace Galaxy
 {
-   Particle* Build( Universe& out_particles, ObjectColors col, float x, float y, float radius, size_t particles );
-
-   using ParticleManipulator = std::function<void( Particle* )>;
-   ParticleManipulator GenerateRotationAlgorithm( Particle* blackhole, bool clockwise );
+   // Every star draws from its own stream of the seed so the same seed gives the same galaxy on any number of threads,
+   // the stars start on circular orbits around the blackhole
+   size_t Build( Universe& out_particles, ObjectColors col, float x, float y, float radius, size_t particles, bool clockwise, uint64_t seed );
 
-   static constexpr const float GAMMA = 0.0000014f;
+   static constexpr const float BLACKHOLE_MASS = 1453.485f;
 };
@@ -0,0 +1,283 @@
+/*
+MIT License
+
+Copyright (c) 2018 Chris McArthur, prince.chrismc(at)gmail(dot)com
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+
+#if defined( __AVX512F__ ) || defined( __AVX2__ )
+#include <immintrin.h>
+#endif
+
+namespace Gravity
+{
+   static constexpr const float GAMMA = 0.000001f;
+
+   // Plummer softening keeps close encounters finite, a body at a distance of zero ( itself ) adds nothing
+   static constexpr const float SOFTENING = 0.005f;
+   static constexpr const float SOFTENING2 = SOFTENING * SOFTENING;
+
+   // Adds the acceleration at { x, y } caused by `count` bodies
+   inline void accumulate( float x, float y, const float* body_x, const float* body_y, const float* body_mass, size_t count,
+                           float& acc_x, float& acc_y );
+
+   // Adds the acceleration at { x, y } caused by a cell's monopole and traceless quadrupole { xx, xy, yy }, the gradient
+   // of m / r + d^T Q d / ( 2 r^5 ) with the bodies' softening in r so a close cell pulls like its bodies would
+   inline void expand( float x, float y, float cell_x, float cell_y, float mass, float q_xx, float q_xy, float q_yy,
+                       float& acc_x, float& acc_y )
+   {
+      const float dx = x - cell_x;
+      const float dy = y - cell_y;
+      const float r2 = dx * dx + dy * dy + SOFTENING2;
+
+      const float inv_r2 = 1.0f / r2;
+      const float inv_r3 = inv_r2 / std::sqrt( r2 );
+      const float inv_r5 = inv_r3 * inv_r2;
+
+      const float qx = q_xx * dx + q_xy * dy;
+      const float qy = q_xy * dx + q_yy * dy;
+      const float k = mass * inv_r3 + 2.5f * ( dx * qx + dy * qy ) * inv_r5 * inv_r2;
+
+      acc_x += GAMMA * ( qx * inv_r5 - k * dx );
+      acc_y += GAMMA * ( qy * inv_r5 - k * dy );
+   }
+
+   // Same as expand for `count` cells
+   inline void accumulateExpansions( float x, float y, const float* cell_x, const float* cell_y, const float* cell_mass,
+                                     const float* cell_xx, const float* cell_xy, const float* cell_yy, size_t count,
+                                     float& acc_x, float& acc_y );
+
+#if defined( __AVX512F__ )
+   static constexpr const size_t LANES = 16;
+#elif defined( __AVX2__ )
+   static constexpr const size_t LANES = 8;
+#else
+   static constexpr const size_t LANES = 1;
+#endif
+}
+
+#if defined( __AVX512F__ )
+
+inline void Gravity::accumulate( float x, float y, const float* body_x, const float* body_y, const float* body_mass, size_t count,
+                                 float& acc_x, float& acc_y )
+{
+   const __m512 px = _mm512_set1_ps( x );
+   const __m512 py = _mm512_set1_ps( y );
+   const __m512 eps2 = _mm512_set1_ps( SOFTENING2 );
+   const __m512 zero = _mm512_setzero_ps();
+   __m512 ax = zero;
+   __m512 ay = zero;
+
+   for( size_t i = 0; i < count; i += LANES )
+   {
+      const __mmask16 lanes = count - i >= LANES ? 0xFFFF : static_cast<__mmask16>( ( 1u << ( count - i ) ) - 1 );
+
+      const __m512 dx = _mm512_sub_ps( _mm512_maskz_loadu_ps( lanes, body_x + i ), px );
+      const __m512 dy = _mm512_sub_ps( _mm512_maskz_loadu_ps( lanes, body_y + i ), py );
+      const __m512 m = _mm512_maskz_loadu_ps( lanes, body_mass + i );
+
+      const __m512 r2 = _mm512_fmadd_ps( dx, dx, _mm512_fmadd_ps( dy, dy, eps2 ) );
+      const __m512 k = _mm512_maskz_div_ps( lanes, m, _mm512_mul_ps( r2, _mm512_sqrt_ps( r2 ) ) );
+
+      ax = _mm512_fmadd_ps( k, dx, ax );
+      ay = _mm512_fmadd_ps( k, dy, ay );
+   }
+
+   acc_x += GAMMA * _mm512_reduce_add_ps( ax );
+   acc_y += GAMMA * _mm512_reduce_add_ps( ay );
+}
+
+inline void Gravity::accumulateExpansions( float x, float y, const float* cell_x, const float* cell_y, const float* cell_mass,
+                                           const float* cell_xx, const float* cell_xy, const float* cell_yy, size_t count,
+                                           float& acc_x, float& acc_y )
+{
+   const __m512 px = _mm512_set1_ps( x );
+   const __m512 py = _mm512_set1_ps( y );
+   const __m512 eps2 = _mm512_set1_ps( SOFTENING2 );
+   const __m512 one = _mm512_set1_ps( 1.0f );
+   const __m512 half5 = _mm512_set1_ps( 2.5f );
+   const __m512 zero = _mm512_setzero_ps();
+   __m512 ax = zero;
+   __m512 ay = zero;
+
+   for( size_t i = 0; i < count; i += LANES )
+   {
+      const __mmask16 lanes = count - i >= LANES ? 0xFFFF : static_cast<__mmask16>( ( 1u << ( count - i ) ) - 1 );
+
+      // masked out lanes have neither mass nor quadrupole and add nothing
+      const __m512 dx = _mm512_sub_ps( px, _mm512_maskz_loadu_ps( lanes, cell_x + i ) );
+      const __m512 dy = _mm512_sub_ps( py, _mm512_maskz_loadu_ps( lanes, cell_y + i ) );
+      const __m512 m = _mm512_maskz_loadu_ps( lanes, cell_mass + i );
+      const __m512 q_xx = _mm512_maskz_loadu_ps( lanes, cell_xx + i );
+      const __m512 q_xy = _mm512_maskz_loadu_ps( lanes, cell_xy + i );
+      const __m512 q_yy = _mm512_maskz_loadu_ps( lanes, cell_yy + i );
+
+      const __m512 r2 = _mm512_fmadd_ps( dx, dx, _mm512_fmadd_ps( dy, dy, eps2 ) );
+      const __m512 inv_r2 = _mm512_div_ps( one, r2 );
+      const __m512 inv_r3 = _mm512_div_ps( inv_r2, _mm512_sqrt_ps( r2 ) );
+      const __m512 inv_r5 = _mm512_mul_ps( inv_r3, inv_r2 );
+
+      const __m512 qx = _mm512_fmadd_ps( q_xx, dx, _mm512_mul_ps( q_xy, dy ) );
+      const __m512 qy = _mm512_fmadd_ps( q_xy, dx, _mm512_mul_ps( q_yy, dy ) );
+      const __m512 dqd = _mm512_fmadd_ps( dx, qx, _mm512_mul_ps( dy, qy ) );
+      const __m512 k = _mm512_fmadd_ps( m, inv_r3, _mm512_mul_ps( _mm512_mul_ps( half5, dqd ), _mm512_mul_ps( inv_r5, inv_r2 ) ) );
+
+      ax = _mm512_add_ps( ax, _mm512_fmsub_ps( qx, inv_r5, _mm512_mul_ps( k, dx ) ) );
+      ay = _mm512_add_ps( ay, _mm512_fmsub_ps( qy, inv_r5, _mm512_mul_ps( k, dy ) ) );
+   }
+
+   acc_x += GAMMA * _mm512_reduce_add_ps( ax );
+   acc_y += GAMMA * _mm512_reduce_add_ps( ay );
+}
+
+#elif defined( __AVX2__ )
+
+inline void Gravity::accumulate( float x, float y, const float* body_x, const float* body_y, const float* body_mass, size_t count,
+                                 float& acc_x, float& acc_y )
+{
+   static const int TAIL_MASKS[ 2 * LANES ] = { -1, -1, -1, -1, -1, -1, -1, -1, 0, 0, 0, 0, 0, 0, 0, 0 };
+
+   const __m256 px = _mm256_set1_ps( x );
+   const __m256 py = _mm256_set1_ps( y );
+   const __m256 eps2 = _mm256_set1_ps( SOFTENING2 );
+   const __m256 zero = _mm256_setzero_ps();
+   __m256 ax = zero;
+   __m256 ay = zero;
+
+   for( size_t i = 0; i < count; i += LANES )
+   {
+      const size_t remaining = count - i >= LANES ? LANES : count - i;
+      const __m256i lanes = _mm256_loadu_si256( reinterpret_cast<const __m256i*>( TAIL_MASKS + LANES - remaining ) );
+
+      const __m256 dx = _mm256_sub_ps( _mm256_maskload_ps( body_x + i, lanes ), px );
+      const __m256 dy = _mm256_sub_ps( _mm256_maskload_ps( body_y + i, lanes ), py );
+      const __m256 m = _mm256_maskload_ps( body_mass + i, lanes );
+
+      const __m256 r2 = _mm256_add_ps( _mm256_add_ps( _mm256_mul_ps( dx, dx ), _mm256_mul_ps( dy, dy ) ), eps2 );
+      const __m256 k = _mm256_div_ps( m, _mm256_mul_ps( r2, _mm256_sqrt_ps( r2 ) ) ); // masked out lanes have no mass
+
+      ax = _mm256_add_ps( ax, _mm256_mul_ps( k, dx ) );
+      ay = _mm256_add_ps( ay, _mm256_mul_ps( k, dy ) );
+   }
+
+   const auto reduce = []( __m256 v ) -> float
+   {
+      __m128 sum = _mm_add_ps( _mm256_castps256_ps128( v ), _mm256_extractf128_ps( v, 1 ) );
+      sum = _mm_add_ps( sum, _mm_movehl_ps( sum, sum ) );
+      sum = _mm_add_ss( sum, _mm_movehdup_ps( sum ) );
+      return _mm_cvtss_f32( sum );
+   };
+
+   acc_x += GAMMA * reduce( ax );
+   acc_y += GAMMA * reduce( ay );
+}
+
+inline void Gravity::accumulateExpansions( float x, float y, const float* cell_x, const float* cell_y, const float* cell_mass,
+                                           const float* cell_xx, const float* cell_xy, const float* cell_yy, size_t count,
+                                           float& acc_x, float& acc_y )
+{
+   static const int TAIL_MASKS[ 2 * LANES ] = { -1, -1, -1, -1, -1, -1, -1, -1, 0, 0, 0, 0, 0, 0, 0, 0 };
+
+   const __m256 px = _mm256_set1_ps( x );
+   const __m256 py = _mm256_set1_ps( y );
+   const __m256 eps2 = _mm256_set1_ps( SOFTENING2 );
+   const __m256 one = _mm256_set1_ps( 1.0f );
+   const __m256 half5 = _mm256_set1_ps( 2.5f );
+   const __m256 zero = _mm256_setzero_ps();
+   __m256 ax = zero;
+   __m256 ay = zero;
+
+   for( size_t i = 0; i < count; i += LANES )
+   {
+      const size_t remaining = count - i >= LANES ? LANES : count - i;
+      const __m256i lanes = _mm256_loadu_si256( reinterpret_cast<const __m256i*>( TAIL_MASKS + LANES - remaining ) );
+
+      // masked out lanes have neither mass nor quadrupole and add nothing
+      const __m256 dx = _mm256_sub_ps( px, _mm256_maskload_ps( cell_x + i, lanes ) );
+      const __m256 dy = _mm256_sub_ps( py, _mm256_maskload_ps( cell_y + i, lanes ) );
+      const __m256 m = _mm256_maskload_ps( cell_mass + i, lanes );
+      const __m256 q_xx = _mm256_maskload_ps( cell_xx + i, lanes );
+      const __m256 q_xy = _mm256_maskload_ps( cell_xy + i, lanes );
+      const __m256 q_yy = _mm256_maskload_ps( cell_yy + i, lanes );
+
+      const __m256 r2 = _mm256_add_ps( _mm256_add_ps( _mm256_mul_ps( dx, dx ), _mm256_mul_ps( dy, dy ) ), eps2 );
+      const __m256 inv_r2 = _mm256_div_ps( one, r2 );
+      const __m256 inv_r3 = _mm256_div_ps( inv_r2, _mm256_sqrt_ps( r2 ) );
+      const __m256 inv_r5 = _mm256_mul_ps( inv_r3, inv_r2 );
+
+      const __m256 qx = _mm256_add_ps( _mm256_mul_ps( q_xx, dx ), _mm256_mul_ps( q_xy, dy ) );
+      const __m256 qy = _mm256_add_ps( _mm256_mul_ps( q_xy, dx ), _mm256_mul_ps( q_yy, dy ) );
+      const __m256 dqd = _mm256_add_ps( _mm256_mul_ps( dx, qx ), _mm256_mul_ps( dy, qy ) );
+      const __m256 k = _mm256_add_ps( _mm256_mul_ps( m, inv_r3 ), _mm256_mul_ps( _mm256_mul_ps( half5, dqd ), _mm256_mul_ps( inv_r5, inv_r2 ) ) );
+
+      ax = _mm256_add_ps( ax, _mm256_sub_ps( _mm256_mul_ps( qx, inv_r5 ), _mm256_mul_ps( k, dx ) ) );
+      ay = _mm256_add_ps( ay, _mm256_sub_ps( _mm256_mul_ps( qy, inv_r5 ), _mm256_mul_ps( k, dy ) ) );
+   }
+
+   const auto reduce = []( __m256 v ) -> float
+   {
+      __m128 sum = _mm_add_ps( _mm256_castps256_ps128( v ), _mm256_extractf128_ps( v, 1 ) );
+      sum = _mm_add_ps( sum, _mm_movehl_ps( sum, sum ) );
+      sum = _mm_add_ss( sum, _mm_movehdup_ps( sum ) );
+      return _mm_cvtss_f32( sum );
+   };
+
+   acc_x += GAMMA * reduce( ax );
+   acc_y += GAMMA * reduce( ay );
+}
+
+#else
+
+inline void Gravity::accumulate( float x, float y, const float* body_x, const float* body_y, const float* body_mass, size_t count,
+                                 float& acc_x, float& acc_y )
+{
+   float ax = 0.0f;
+   float ay = 0.0f;
+
+   for( size_t i = 0; i < count; i++ )
+   {
+      const float dx = body_x[ i ] - x;
+      const float dy = body_y[ i ] - y;
+      const float r2 = dx * dx + dy * dy + SOFTENING2;
+
+      const float k = body_mass[ i ] / ( r2 * sqrt( r2 ) );
+      ax += k * dx;
+      ay += k * dy;
+   }
+
+   acc_x += GAMMA * ax;
+   acc_y += GAMMA * ay;
+}
+
+inline void Gravity::accumulateExpansions( float x, float y, const float* cell_x, const float* cell_y, const float* cell_mass,
+                                           const float* cell_xx, const float* cell_xy, const float* cell_yy, size_t count,
+                                           float& acc_x, float& acc_y )
+{
+   for( size_t i = 0; i < count; i++ )
+      expand( x, y, cell_x[ i ], cell_y[ i ], cell_mass[ i ], cell_xx[ i ], cell_xy[ i ], cell_yy[ i ], acc_x, acc_y );
+}
+
+#endif
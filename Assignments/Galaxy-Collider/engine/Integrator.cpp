@@ -0,0 +1,141 @@
+/*
+MIT License
+
+Copyright (c) 2018 Chris McArthur, prince.chrismc(at)gmail(dot)com
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+
+#include "Integrator.h"
+#include "Gravity.h"
+#include "tbb/blocked_range.h"
+#include "tbb/parallel_reduce.h"
+#include <algorithm>
+#include <cmath>
+
+void Integrator::step( Universe& universe, size_t particles, const AccelerationSolver& solve )
+{
+   if( particles == 0 ) return;
+
+   // The first call has no accelerations yet
+   if( m_Rungs.size() != particles )
+   {
+      m_Rungs.assign( particles, 0 );
+      m_Active.assign( particles, 1 );
+      solve( m_Active );
+      m_ForceEvaluations += particles;
+      for( size_t i = 0; i < particles; i++ ) m_Rungs[ i ] = static_cast<uint8_t>( calcRung( universe, i ) );
+   }
+
+   // Every particle starts a step at tick 0, each substep then drifts everyone up to the end of the shortest step in use
+   unsigned rung = kick( universe, particles, 0 );
+   for( unsigned tick = 0; tick < TICKS; )
+   {
+      tick += TICKS >> rung;
+      const size_t active = drift( universe, particles, getTimestep( rung ), tick );
+
+      solve( m_Active );
+      m_ForceEvaluations += active;
+
+      rung = kick( universe, particles, tick );
+   }
+}
+
+void Integrator::restore( const std::vector<uint8_t>& rungs, size_t evaluations )
+{
+   m_Rungs = rungs;
+   m_Active.assign( rungs.size(), 1 );
+   m_ForceEvaluations = evaluations;
+}
+
+unsigned Integrator::kick( Universe& universe, size_t particles, unsigned tick )
+{
+   return tbb::parallel_reduce(
+      tbb::blocked_range<size_t>( 0, particles ), 0u,
+      [ this, &universe, tick ]( const tbb::blocked_range<size_t>& range, unsigned shortest )
+      {
+         for( size_t i = range.begin(); i < range.end(); i++ )
+         {
+            float kickTime = 0.0f;
+            if( tick == 0 )
+               kickTime = getTimestep( m_Rungs[ i ] ) / 2.0f;
+            else if( m_Active[ i ] )
+            {
+               // Close the step ending at this tick and open the next one, a particle may only move to a longer step
+               // when this tick is on that step's boundary so it stays synchronised with the others
+               kickTime = getTimestep( m_Rungs[ i ] ) / 2.0f;
+               if( tick < TICKS )
+               {
+                  unsigned next = calcRung( universe, i );
+                  while( next < m_Rungs[ i ] && tick % ( TICKS >> next ) != 0 ) next++;
+
+                  m_Rungs[ i ] = static_cast<uint8_t>( next );
+                  kickTime += getTimestep( next ) / 2.0f;
+               }
+               else
+                  m_Rungs[ i ] = static_cast<uint8_t>( calcRung( universe, i ) ); // opened by the next call
+            }
+
+            if( kickTime != 0.0f )
+            {
+               universe.m_VX[ i ] += universe.m_AX[ i ] * kickTime;
+               universe.m_VY[ i ] += universe.m_AY[ i ] * kickTime;
+            }
+            shortest = std::max<unsigned>( shortest, m_Rungs[ i ] );
+         }
+         return shortest;
+      },
+      []( unsigned a, unsigned b ) { return std::max( a, b ); }
+   );
+}
+
+size_t Integrator::drift( Universe& universe, size_t particles, float dt, unsigned tick )
+{
+   // A particle is active when its step ends at this tick
+   return tbb::parallel_reduce(
+      tbb::blocked_range<size_t>( 0, particles ), size_t{ 0 },
+      [ this, &universe, dt, tick ]( const tbb::blocked_range<size_t>& range, size_t active )
+      {
+         for( size_t i = range.begin(); i < range.end(); i++ )
+         {
+            universe.m_X[ i ] += universe.m_VX[ i ] * dt;
+            universe.m_Y[ i ] += universe.m_VY[ i ] * dt;
+
+            m_Active[ i ] = tick % ( TICKS >> m_Rungs[ i ] ) == 0;
+            active += m_Active[ i ];
+         }
+         return active;
+      },
+      []( size_t a, size_t b ) { return a + b; }
+   );
+}
+
+unsigned Integrator::calcRung( const Universe& universe, size_t particle ) const
+{
+   if( !m_Adaptive ) return 0;
+
+   const float acc = std::sqrt( universe.m_AX[ particle ] * universe.m_AX[ particle ] + universe.m_AY[ particle ] * universe.m_AY[ particle ] );
+   if( acc <= 0.0f ) return 0;
+
+   const float dt = std::sqrt( 2.0f * ETA * Gravity::SOFTENING / acc );
+   const int rung = static_cast<int>( std::ceil( std::log2( m_Timestep / dt ) ) );
+   return static_cast<unsigned>( std::min( std::max( rung, 0 ), static_cast<int>( MAX_RUNG ) ) );
+}
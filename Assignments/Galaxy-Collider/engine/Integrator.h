@@ -0,0 +1,84 @@
+/*
+MIT License
+
+Copyright (c) 2018 Chris McArthur, prince.chrismc(at)gmail(dot)com
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+#pragma once
+
+#include "Universe.h"
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+// Kick-drift-kick leapfrog, every call advances the universe by one timestep. In adaptive mode each particle steps with
+// timestep / 2^rung where the rung follows its acceleration, the particles are synchronised again at the end of the call.
+// Only the particles whose step ends on a substep are active and need a new acceleration, the others are drifted along
+// with their half kicked velocity which is their predicted position at that time
+class Integrator
+{
+public:
+   // Fills m_AX / m_AY of the universe for the current positions of the particles flagged as active, called once per
+   // substep so the type erasure costs nothing next to the solve
+   using AccelerationSolver = std::function<void( const std::vector<uint8_t>& active )>;
+
+   void step( Universe& universe, size_t particles, const AccelerationSolver& solve );
+
+   void setTimestep( float dt ) { m_Timestep = dt; }
+   void setAdaptive( bool adaptive ) { m_Adaptive = adaptive; }
+   float getTimestep() const { return m_Timestep; }
+   bool isAdaptive() const { return m_Adaptive; }
+
+   // Accelerations computed so far, one per active particle of every substep
+   size_t getForceEvaluations() const { return m_ForceEvaluations; }
+
+   // Between two calls every particle sits at the start of a step on its rung, restoring them along with the universe's
+   // accelerations skips the initial solve. Without rungs the next call starts over with one
+   const std::vector<uint8_t>& getRungs() const { return m_Rungs; }
+   void restore( const std::vector<uint8_t>& rungs, size_t evaluations );
+
+   // Largest fixed step that keeps the energy of the default collision within a percent, adaptive steps may use 1.0f
+   static constexpr const float DEFAULT_TIMESTEP = 0.0625f;
+   static constexpr const unsigned MAX_RUNG = 6;
+
+private:
+   float m_Timestep{ DEFAULT_TIMESTEP };
+   bool m_Adaptive{ false };
+   size_t m_ForceEvaluations{ 0 };
+
+   std::vector<uint8_t> m_Rungs;
+   std::vector<uint8_t> m_Active;
+
+   // Ticks of the smallest timestep per call
+   static constexpr const unsigned TICKS = 1u << MAX_RUNG;
+
+   // Accuracy of the adaptive timestep, dt = sqrt( 2 ETA SOFTENING / |a| )
+   static constexpr const float ETA = 0.025f;
+
+   float getTimestep( unsigned rung ) const { return m_Timestep / static_cast<float>( 1u << rung ); }
+   unsigned calcRung( const Universe& universe, size_t particle ) const;
+
+   // Each substep streams the particles twice, the kicks ( closing and opening ) also pick the new rungs and return the
+   // shortest one while the drift flags the particles that will be active at the end of it
+   unsigned kick( Universe& universe, size_t particles, unsigned tick );
+   size_t drift( Universe& universe, size_t particles, float dt, unsigned tick );
+};
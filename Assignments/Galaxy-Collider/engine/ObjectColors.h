@@ -25,3 +25,6 @@ SOFTWARE.
 #pragma once
 
 enum class ObjectColors { RED, GREEN, BLUE, GREY, YELLOW, TEAL };
+
+// Entries of the vertex shader's PALETTE, one per color
+static constexpr const unsigned PALETTE_SIZE = static_cast<unsigned>( ObjectColors::TEAL ) + 1;
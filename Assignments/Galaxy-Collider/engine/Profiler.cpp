@@ -0,0 +1,260 @@
+/*
+MIT License
+
+Copyright (c) 2018 Chris McArthur, prince.chrismc(at)gmail(dot)com
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+#include "Profiler.h"
+#include "CountedAllocator.h"
+#include "tbb/task_arena.h"
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+
+#if defined( _WIN32 )
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+#if defined( GALAXY_COLLIDER_ITT )
+#include <ittnotify.h>
+#endif
+
+#if defined( GALAXY_COLLIDER_COUNT_ALLOCATIONS )
+#include <cstdlib>
+#include <new>
+#if defined( _WIN32 )
+#include <malloc.h>
+#endif
+
+static std::atomic<int64_t> s_Allocations{ 0 };
+
+void Allocations::count() { s_Allocations.fetch_add( 1, std::memory_order_relaxed ); }
+
+// The array and nothrow forms call these, the aligned ones back std::vector<Cell> and anything else over-aligned
+void* operator new( size_t size )
+{
+   Allocations::count();
+   if( void* p = std::malloc( size ? size : 1 ) ) return p;
+   throw std::bad_alloc();
+}
+
+void* operator new( size_t size, std::align_val_t alignment )
+{
+   Allocations::count();
+#if defined( _WIN32 )
+   if( void* p = _aligned_malloc( size ? size : 1, static_cast<size_t>( alignment ) ) ) return p;
+#else
+   void* p = nullptr;
+   if( posix_memalign( &p, std::max( static_cast<size_t>( alignment ), sizeof( void* ) ), size ? size : 1 ) == 0 ) return p;
+#endif
+   throw std::bad_alloc();
+}
+
+void operator delete( void* p ) noexcept { std::free( p ); }
+void operator delete( void* p, size_t ) noexcept { std::free( p ); }
+
+#if defined( _WIN32 )
+void operator delete( void* p, std::align_val_t ) noexcept { _aligned_free( p ); }
+void operator delete( void* p, size_t, std::align_val_t ) noexcept { _aligned_free( p ); }
+#else
+void operator delete( void* p, std::align_val_t ) noexcept { std::free( p ); }
+void operator delete( void* p, size_t, std::align_val_t ) noexcept { std::free( p ); }
+#endif
+
+static int64_t getAllocations() { return s_Allocations.load( std::memory_order_relaxed ); }
+#else
+void Allocations::count() {}
+
+static int64_t getAllocations() { return -1; }
+#endif
+
+namespace
+{
+   double getProcessCpuTime()
+   {
+#if defined( _WIN32 )
+      FILETIME creation, exit, kernel, user;
+      if( !GetProcessTimes( GetCurrentProcess(), &creation, &exit, &kernel, &user ) ) return 0.0;
+
+      const auto seconds = []( const FILETIME& time ) { return ( ( static_cast<uint64_t>( time.dwHighDateTime ) << 32 ) | time.dwLowDateTime ) * 1e-7; };
+      return seconds( kernel ) + seconds( user );
+#else
+      timespec now;
+      clock_gettime( CLOCK_PROCESS_CPUTIME_ID, &now );
+      return now.tv_sec + now.tv_nsec * 1e-9;
+#endif
+   }
+
+#if defined( GALAXY_COLLIDER_ITT )
+   __itt_domain* const s_Domain = __itt_domain_create( "Galaxy-Collider" );
+   __itt_string_handle* const s_PhaseHandles[ Profiler::PHASES ] = {
+      __itt_string_handle_create( Profiler::getPhaseName( Profiler::TREE ) ),
+      __itt_string_handle_create( Profiler::getPhaseName( Profiler::MOMENTS ) ),
+      __itt_string_handle_create( Profiler::getPhaseName( Profiler::FORCE ) ),
+      __itt_string_handle_create( Profiler::getPhaseName( Profiler::INTEGRATE ) ),
+      __itt_string_handle_create( Profiler::getPhaseName( Profiler::RENDER ) ) };
+#endif
+}
+
+Profiler::Profiler( size_t capacity ) : m_Samples( capacity )
+{
+}
+
+Profiler::Scope::Scope( Profiler& profiler, Phase phase ) : m_Profiler( profiler ), m_Phase( phase ), m_Timed( profiler.m_Enabled )
+{
+#if defined( GALAXY_COLLIDER_ITT )
+   __itt_task_begin( s_Domain, __itt_null, __itt_null, s_PhaseHandles[ phase ] );
+#endif
+   if( m_Timed ) m_Start = std::chrono::steady_clock::now();
+}
+
+Profiler::Scope::~Scope()
+{
+#if defined( GALAXY_COLLIDER_ITT )
+   __itt_task_end( s_Domain );
+#endif
+   if( !m_Timed ) return;
+
+   const auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>( std::chrono::steady_clock::now() - m_Start );
+   m_Profiler.m_Elapsed[ m_Phase ].fetch_add( static_cast<uint64_t>( elapsed.count() ), std::memory_order_relaxed );
+}
+
+void Profiler::beginStep()
+{
+   if( !m_Enabled ) return;
+
+   m_StepStart = std::chrono::steady_clock::now();
+   m_StepCpuStart = getProcessCpuTime();
+   m_StepAllocationsStart = getAllocations();
+}
+
+void Profiler::endStep( const Counters& counters )
+{
+   if( !m_Enabled || m_Samples.empty() ) return;
+
+   const std::chrono::duration<double> wall = std::chrono::steady_clock::now() - m_StepStart;
+   const double cpu = getProcessCpuTime() - m_StepCpuStart;
+   const int64_t allocations = getAllocations();
+
+   Sample& sample = m_Samples[ m_Recorded % m_Samples.size() ];
+   sample.m_Step = m_Recorded++;
+   sample.m_Counters = counters;
+   sample.m_Utilisation = wall.count() > 0.0 ? cpu / ( wall.count() * tbb::this_task_arena::max_concurrency() ) : 0.0;
+   sample.m_Allocations = allocations < 0 ? -1 : allocations - m_StepAllocationsStart;
+
+   double timed = 0.0;
+   for( int phase = 0; phase < PHASES; phase++ )
+   {
+      sample.m_Seconds[ phase ] = m_Elapsed[ phase ].exchange( 0, std::memory_order_relaxed ) * 1e-9;
+      if( phase != INTEGRATE && phase != RENDER ) timed += sample.m_Seconds[ phase ];
+   }
+   sample.m_Seconds[ INTEGRATE ] += std::max( wall.count() - timed, 0.0 );
+}
+
+std::vector<Profiler::Sample> Profiler::getSamples() const
+{
+   std::vector<Sample> samples;
+   if( m_Samples.empty() ) return samples;
+
+   const uint64_t first = m_Recorded > m_Samples.size() ? m_Recorded - m_Samples.size() : 0;
+   for( uint64_t step = first; step < m_Recorded; step++ )
+      samples.push_back( m_Samples[ step % m_Samples.size() ] );
+
+   return samples;
+}
+
+bool Profiler::exportCsv( const std::string& path ) const
+{
+   std::ofstream out( path );
+   if( !out ) return false;
+
+   out << "step";
+   for( int phase = 0; phase < PHASES; phase++ ) out << "," << getPhaseName( static_cast<Phase>( phase ) ) << "_s";
+   out << ",nodes,depth,force_evaluations,interactions_per_particle,utilisation,allocations\n";
+
+   out << std::setprecision( 9 );
+   for( const Sample& sample : getSamples() )
+   {
+      const Counters& counters = sample.m_Counters;
+      out << sample.m_Step;
+      for( double seconds : sample.m_Seconds ) out << "," << seconds;
+      out << "," << counters.m_Nodes << "," << counters.m_Depth << "," << counters.m_ForceEvaluations << ","
+          << ( counters.m_ForceEvaluations ? static_cast<double>( counters.m_Interactions ) / counters.m_ForceEvaluations : 0.0 ) << ","
+          << sample.m_Utilisation << ",";
+      if( sample.m_Allocations >= 0 ) out << sample.m_Allocations;
+      out << "\n";
+   }
+
+   return static_cast<bool>( out );
+}
+
+bool Profiler::exportJson( const std::string& path ) const
+{
+   std::ofstream out( path );
+   if( !out ) return false;
+
+   out << std::setprecision( 9 ) << "[\n";
+   const std::vector<Sample> samples = getSamples();
+   for( size_t i = 0; i < samples.size(); i++ )
+   {
+      const Sample& sample = samples[ i ];
+      const Counters& counters = sample.m_Counters;
+
+      out << "  { \"step\": " << sample.m_Step << ", \"seconds\": { ";
+      for( int phase = 0; phase < PHASES; phase++ )
+         out << ( phase ? ", " : "" ) << "\"" << getPhaseName( static_cast<Phase>( phase ) ) << "\": " << sample.m_Seconds[ phase ];
+      out << " }, \"nodes\": " << counters.m_Nodes << ", \"depth\": " << counters.m_Depth
+          << ", \"force_evaluations\": " << counters.m_ForceEvaluations << ", \"interactions_per_particle\": "
+          << ( counters.m_ForceEvaluations ? static_cast<double>( counters.m_Interactions ) / counters.m_ForceEvaluations : 0.0 )
+          << ", \"utilisation\": " << sample.m_Utilisation << ", \"allocations\": ";
+      if( sample.m_Allocations >= 0 ) out << sample.m_Allocations; else out << "null";
+      out << " }" << ( i + 1 < samples.size() ? "," : "" ) << "\n";
+   }
+   out << "]\n";
+
+   return static_cast<bool>( out );
+}
+
+bool Profiler::exportFile( const std::string& path ) const
+{
+   const std::string extension = ".json";
+   if( path.size() >= extension.size() && path.compare( path.size() - extension.size(), extension.size(), extension ) == 0 )
+      return exportJson( path );
+
+   return exportCsv( path );
+}
+
+const char* Profiler::getPhaseName( Phase phase )
+{
+   switch( phase )
+   {
+   case TREE: return "tree";
+   case MOMENTS: return "moments";
+   case FORCE: return "force";
+   case INTEGRATE: return "integrate";
+   case RENDER: return "render";
+   default: return "unknown";
+   }
+}
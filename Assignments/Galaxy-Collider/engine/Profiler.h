@@ -0,0 +1,112 @@
+/*
+MIT License
+
+Copyright (c) 2018 Chris McArthur, prince.chrismc(at)gmail(dot)com
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Per step wall times of the simulation's phases and a few counters, kept in a ring buffer of the last `capacity` steps
+// which can be exported as CSV or JSON. Recording does not allocate and costs a couple of clock reads per phase.
+// Building with GALAXY_COLLIDER_ITT also annotates the phases as ITT tasks so they show up on VTune's timeline.
+class Profiler
+{
+public:
+   enum Phase { TREE, MOMENTS, FORCE, INTEGRATE, RENDER, PHASES };
+
+   struct Counters
+   {
+      size_t m_Nodes{ 0 };
+      unsigned m_Depth{ 0 };
+      size_t m_ForceEvaluations{ 0 };  // one per particle that received an acceleration
+      size_t m_Interactions{ 0 };      // cells, expansions and bodies those particles interacted with
+   };
+
+   struct Sample
+   {
+      uint64_t m_Step;
+      std::array<double, PHASES> m_Seconds;
+      Counters m_Counters;
+      double m_Utilisation;            // process CPU time over wall time times the number of threads
+      int64_t m_Allocations;           // operator new calls ( any form ) and CountedAllocator allocations, -1 unless built with
+                                       // GALAXY_COLLIDER_COUNT_ALLOCATIONS. TBB's own task and scheduler memory is not seen
+   };
+
+   explicit Profiler( size_t capacity = DEFAULT_CAPACITY );
+
+   void setEnabled( bool enabled ) { m_Enabled = enabled; }
+   bool isEnabled() const { return m_Enabled; }
+
+   // Times a phase until the end of the scope, the render thread may time its phase while a step is being recorded
+   class Scope
+   {
+   public:
+      Scope( Profiler& profiler, Phase phase );
+      ~Scope();
+
+      Scope( const Scope& ) = delete;
+      void operator=( const Scope& ) = delete;
+
+   private:
+      Profiler& m_Profiler;
+      Phase m_Phase;
+      bool m_Timed;
+      std::chrono::steady_clock::time_point m_Start;
+   };
+
+   // The integration is whatever time of the step was not spent in the other phases
+   void beginStep();
+   void endStep( const Counters& counters );
+
+   // Oldest first
+   std::vector<Sample> getSamples() const;
+
+   bool exportCsv( const std::string& path ) const;
+   bool exportJson( const std::string& path ) const;
+
+   // Chooses the format from the extension, .json or anything else for CSV
+   bool exportFile( const std::string& path ) const;
+
+   static const char* getPhaseName( Phase phase );
+
+   static constexpr const size_t DEFAULT_CAPACITY = 4096;
+
+private:
+   bool m_Enabled{ false };
+
+   std::vector<Sample> m_Samples;
+   uint64_t m_Recorded{ 0 };
+
+   // Nanoseconds spent in each phase since the last endStep
+   std::array<std::atomic<uint64_t>, PHASES> m_Elapsed{};
+
+   std::chrono::steady_clock::time_point m_StepStart;
+   double m_StepCpuStart{ 0.0 };
+   int64_t m_StepAllocationsStart{ 0 };
+};
@@ -0,0 +1,1061 @@
+/*
+MIT License
+
+Copyright (c) 2018 Chris McArthur, prince.chrismc(at)gmail(dot)com
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+#include "QuadTree.h"
+#include "Gravity.h"
+#include "ObjectColors.h"
+#include "Random.h"
+#include "tbb/parallel_for.h"
+#include "tbb/parallel_sort.h"
+#include "tbb/task_group.h"
+#include "glm/geometric.hpp"
+#include <algorithm>
+#include <atomic>
+#include <climits>
+#include <cmath>
+
+QuadTree::QuadTree( float x_min, float y_min, float size ) :
+   m_Universe( nullptr ), m_MinX( x_min ), m_MinY( y_min ), m_Size( size )
+{
+}
+
+void QuadTree::reset( Universe& universe, size_t bodies )
+{
+   m_Universe = &universe;
+   m_Frame++;
+
+   m_Nodes.clear(); // keeps the internal arrays
+   m_Dropped.clear();
+   m_Leaves.clear();
+   Node& root = *m_Nodes.grow_by( 1 );
+   root.m_MinX = m_MinX;
+   root.m_MinY = m_MinY;
+   root.m_Size = m_Size;
+
+   m_BodyX.resize( bodies );
+   m_BodyY.resize( bodies );
+   m_BodyMass.resize( bodies );
+}
+
+void QuadTree::build( Universe& universe, size_t particles )
+{
+   reset( universe, particles );
+   m_MortonKeys.resize( particles );
+
+   // Bodies are in universe order, every leaf holds a single one
+   tbb::parallel_for(
+      tbb::blocked_range<size_t>( 0, particles ),
+      [ this ]( const tbb::blocked_range<size_t>& range )
+      {
+         for( size_t i = range.begin(); i < range.end(); i++ )
+         {
+            m_BodyX[ i ] = m_Universe->m_X[ i ];
+            m_BodyY[ i ] = m_Universe->m_Y[ i ];
+            m_BodyMass[ i ] = m_Universe->m_Mass[ i ];
+            m_MortonKeys[ i ] = { 0, static_cast<int>( i ) };
+         }
+      }
+   );
+
+   tbb::parallel_for(
+      tbb::blocked_range<size_t>( 0, particles ),
+      [ this ]( const tbb::blocked_range<size_t>& range )
+      {
+         for( size_t i = range.begin(); i < range.end(); i++ )
+            insert( ROOT, static_cast<int>( i ) );
+      }
+   );
+}
+
+void QuadTree::insert( int index, int particle )
+{
+   Node& node = m_Nodes[ index ];
+   const glm::vec2 pos = m_Universe->getPos( particle );
+
+   if( outsideOfRegion( node, pos ) )
+   {
+      if( index == ROOT ) m_Dropped.push_back( particle );
+      return; // Don't even bother =)
+   }
+
+   node.m_InsertLock.lock();
+   if( node.isLeaf() && node.m_TotalParticles == 1 )
+   {
+      const int resident = node.m_Body;
+      if( glm::length( pos - m_Universe->getPos( resident ) ) < TOO_CLOSE )
+      {
+         collide( resident, particle );
+         m_BodyMass[ resident ] = m_Universe->m_Mass[ resident ];
+         m_Dropped.push_back( particle );
+
+         node.m_InsertLock.unlock();
+         return; // The particle is too close just drop it...
+      }
+
+      const int firstChild = makeChildDistricts( node );
+      insert( firstChild + node.determineChildDistrict( m_Universe->getPos( resident ) ), resident );
+      insert( firstChild + node.determineChildDistrict( pos ), particle );
+
+      node.m_FirstChild = firstChild;
+      node.m_Body = EMPTY;
+   }
+   else if( !node.isLeaf() )
+   {
+      node.m_TotalParticles++;
+      node.m_InsertLock.unlock();
+      return insert( node.m_FirstChild + node.determineChildDistrict( pos ), particle );
+   }
+   else
+   {
+      node.m_Body = particle;
+   }
+
+   node.m_TotalParticles++;
+   node.m_InsertLock.unlock();
+}
+
+void QuadTree::buildMorton( Universe& universe, size_t particles )
+{
+   m_Universe = &universe;
+
+   // Starting from the previous frame's order leaves the keys mostly sorted already
+   if( m_MortonKeys.size() != particles )
+   {
+      m_MortonKeys.resize( particles );
+      for( size_t i = 0; i < particles; i++ ) m_MortonKeys[ i ].second = static_cast<int>( i );
+   }
+
+   tbb::parallel_for(
+      tbb::blocked_range<size_t>( 0, particles ),
+      [ this ]( const tbb::blocked_range<size_t>& range )
+      {
+         for( size_t i = range.begin(); i < range.end(); i++ )
+         {
+            const glm::vec2 pos = m_Universe->getPos( m_MortonKeys[ i ].second );
+            const bool outside = pos.x < m_MinX || pos.x > m_MinX + m_Size || pos.y < m_MinY || pos.y > m_MinY + m_Size;
+            m_MortonKeys[ i ].first = outside ? OUTSIDE_OF_REGION : calcMortonKey( pos );
+         }
+      }
+   );
+
+   tbb::parallel_sort( m_MortonKeys.begin(), m_MortonKeys.end() );
+
+   // Particles out of the root were sorted to the end, they are ignored just like with insert
+   const auto inside = std::lower_bound( m_MortonKeys.begin(), m_MortonKeys.end(), std::make_pair( OUTSIDE_OF_REGION, 0 ) );
+   const size_t count = inside - m_MortonKeys.begin();
+
+   reset( universe, count );
+   for( size_t i = count; i < particles; i++ )
+      m_Dropped.push_back( m_MortonKeys[ i ].second );
+   tbb::parallel_for(
+      tbb::blocked_range<size_t>( 0, count ),
+      [ this ]( const tbb::blocked_range<size_t>& range )
+      {
+         for( size_t i = range.begin(); i < range.end(); i++ )
+            copyBody( i );
+      }
+   );
+
+   if( count > 0 ) buildMortonRange( ROOT, 0, count, 0 );
+
+   collectLeaves();
+   m_FramesSinceRebuild = 0;
+}
+
+void QuadTree::update( Universe& universe, size_t particles )
+{
+   m_Universe = &universe;
+
+   if( m_Leaves.empty() || m_MortonKeys.size() != particles || ++m_FramesSinceRebuild >= REBUILD_INTERVAL || !refit( particles ) )
+      buildMorton( universe, particles );
+}
+
+bool QuadTree::refit( size_t particles )
+{
+   m_Frame++;
+
+   // Whoever left its leaf escapes, the others are compacted to the front of the leaf
+   const size_t limit = particles / REFIT_LIMIT;
+   m_Escaped.clear();
+   tbb::parallel_for(
+      tbb::blocked_range<size_t>( 0, m_Leaves.size() ),
+      [ this, limit ]( const tbb::blocked_range<size_t>& range )
+      {
+         for( size_t leaf = range.begin(); leaf < range.end() && m_Escaped.size() <= limit; leaf++ )
+         {
+            Node& node = m_Nodes[ m_Leaves[ leaf ] ];
+            int kept = node.m_Body;
+            for( int body = node.m_Body; body < node.m_Body + static_cast<int>( node.m_TotalParticles ); body++ )
+            {
+               if( outsideOfRegion( node, m_Universe->getPos( m_MortonKeys[ body ].second ) ) )
+                  m_Escaped.push_back( m_MortonKeys[ body ].second );
+               else
+                  std::swap( m_MortonKeys[ kept++ ], m_MortonKeys[ body ] ); // keeps every particle in case of a rebuild
+            }
+            node.m_TotalParticles = static_cast<unsigned>( kept - node.m_Body );
+         }
+      }
+   );
+   for( int particle : m_Dropped ) m_Escaped.push_back( particle ); // maybe they came back
+
+   if( m_Escaped.size() > limit )
+      return false; // the full rebuild is cheaper
+
+   if( m_Escaped.empty() )
+   {
+      // Same layout, only the copies of the bodies are out of date
+      tbb::parallel_for(
+         tbb::blocked_range<size_t>( 0, m_BodyX.size() ),
+         [ this ]( const tbb::blocked_range<size_t>& range )
+         {
+            for( size_t i = range.begin(); i < range.end(); i++ )
+               copyBody( i );
+         }
+      );
+      return true;
+   }
+
+   // Find the leaf each of them moved into, anything out of the root stays dropped
+   m_Dropped.clear();
+   m_Movers.clear();
+   for( int particle : m_Escaped )
+   {
+      const glm::vec2 pos = m_Universe->getPos( particle );
+      if( outsideOfRegion( m_Nodes[ ROOT ], pos ) )
+      {
+         m_Dropped.push_back( particle );
+         continue;
+      }
+
+      int index = ROOT;
+      while( !m_Nodes[ index ].isLeaf() )
+         index = m_Nodes[ index ].m_FirstChild + m_Nodes[ index ].determineChildDistrict( pos );
+      m_Movers.emplace_back( m_LeafOrder[ index ], particle );
+   }
+   std::sort( m_Movers.begin(), m_Movers.end() );
+
+   // Every leaf gets its remaining bodies followed by the ones that moved in, still in Morton order at the leaf level
+   m_LeafOffsets.resize( m_Leaves.size() );
+   size_t count = 0;
+   auto mover = m_Movers.cbegin();
+   for( size_t leaf = 0; leaf < m_Leaves.size(); leaf++ )
+   {
+      m_LeafOffsets[ leaf ] = count;
+      count += m_Nodes[ m_Leaves[ leaf ] ].m_TotalParticles;
+      for( ; mover != m_Movers.cend() && mover->first == static_cast<int>( leaf ); mover++ ) count++;
+   }
+
+   m_RefitKeys.resize( particles );
+   tbb::parallel_for(
+      tbb::blocked_range<size_t>( 0, m_Leaves.size() ),
+      [ this ]( const tbb::blocked_range<size_t>& range )
+      {
+         for( size_t leaf = range.begin(); leaf < range.end(); leaf++ )
+         {
+            Node& node = m_Nodes[ m_Leaves[ leaf ] ];
+            size_t body = m_LeafOffsets[ leaf ];
+            for( int kept = node.m_Body; kept < node.m_Body + static_cast<int>( node.m_TotalParticles ); kept++ )
+               m_RefitKeys[ body++ ].second = m_MortonKeys[ kept ].second;
+
+            for( auto mover = std::lower_bound( m_Movers.cbegin(), m_Movers.cend(), std::make_pair( static_cast<int>( leaf ), INT_MIN ) );
+                 mover != m_Movers.cend() && mover->first == static_cast<int>( leaf ); mover++ )
+               m_RefitKeys[ body++ ].second = mover->second;
+
+            node.m_Body = static_cast<int>( m_LeafOffsets[ leaf ] );
+            node.m_TotalParticles = static_cast<unsigned>( body - m_LeafOffsets[ leaf ] );
+         }
+      }
+   );
+   for( size_t i = 0; i < m_Dropped.size(); i++ )
+      m_RefitKeys[ count + i ] = { OUTSIDE_OF_REGION, m_Dropped[ i ] };
+   std::swap( m_MortonKeys, m_RefitKeys );
+
+   m_BodyX.resize( count );
+   m_BodyY.resize( count );
+   m_BodyMass.resize( count );
+   tbb::parallel_for(
+      tbb::blocked_range<size_t>( 0, count ),
+      [ this ]( const tbb::blocked_range<size_t>& range )
+      {
+         for( size_t i = range.begin(); i < range.end(); i++ )
+         {
+            m_MortonKeys[ i ].first = calcMortonKey( m_Universe->getPos( m_MortonKeys[ i ].second ) );
+            copyBody( i );
+         }
+      }
+   );
+
+   refitNode( ROOT, 0 );
+   collectLeaves();
+   return true;
+}
+
+unsigned QuadTree::refitNode( int index, int level )
+{
+   Node& node = m_Nodes[ index ];
+
+   if( node.isLeaf() )
+   {
+      if( node.m_TotalParticles <= LEAF_CAPACITY || level == MORTON_LEVELS )
+         return node.m_TotalParticles;
+
+      // Split, the bodies only need to be sorted within the leaf
+      const size_t begin = node.m_Body, end = begin + node.m_TotalParticles;
+      std::sort( m_MortonKeys.begin() + begin, m_MortonKeys.begin() + end );
+      for( size_t body = begin; body < end; body++ )
+         copyBody( body );
+
+      node.m_Body = EMPTY;
+      return buildMortonRange( index, begin, end, level );
+   }
+
+   unsigned kept[ 4 ] = { 0, 0, 0, 0 };
+   if( node.m_TotalParticles > MORTON_GRAIN_SIZE )
+   {
+      tbb::task_group g;
+      for( int child = NE; child <= NW; child++ )
+      {
+         unsigned* out = &kept[ child ];
+         g.run( [ this, &node, child, level, out ] { *out = refitNode( node.m_FirstChild + child, level + 1 ); } );
+      }
+      g.wait();
+   }
+   else
+   {
+      for( int child = NE; child <= NW; child++ )
+         kept[ child ] = refitNode( node.m_FirstChild + child, level + 1 );
+   }
+
+   node.m_TotalParticles = kept[ 0 ] + kept[ 1 ] + kept[ 2 ] + kept[ 3 ];
+
+   // Merge children which no longer need to be split, sibling leaves have consecutive bodies
+   bool leaves = true;
+   for( int child = node.m_FirstChild; child < node.m_FirstChild + 4; child++ ) leaves &= m_Nodes[ child ].isLeaf();
+
+   if( leaves && node.m_TotalParticles <= LEAF_CAPACITY )
+   {
+      node.m_Body = m_Nodes[ node.m_FirstChild + DIGIT_TO_DISTRICT[ 0 ] ].m_Body;
+      node.m_FirstChild = EMPTY;
+   }
+
+   return node.m_TotalParticles;
+}
+
+void QuadTree::collectLeaves()
+{
+   m_Leaves.clear();
+   m_LeafOrder.resize( m_Nodes.size() );
+   collectLeaves( ROOT );
+}
+
+void QuadTree::collectLeaves( int index )
+{
+   const Node& node = m_Nodes[ index ];
+   if( node.isLeaf() )
+   {
+      m_LeafOrder[ index ] = static_cast<int>( m_Leaves.size() );
+      m_Leaves.push_back( index );
+      return;
+   }
+
+   for( District district : DIGIT_TO_DISTRICT )
+      collectLeaves( node.m_FirstChild + district );
+}
+
+void QuadTree::getLayout( Layout& layout ) const
+{
+   // assign keeps the capacity so a recycled layout does not allocate
+   const size_t nodes = m_Leaves.empty() ? 0 : m_Nodes.size();
+   const size_t keys = m_Leaves.empty() ? 0 : m_MortonKeys.size();
+   layout.m_Keys.resize( keys );
+   layout.m_Particles.resize( keys );
+   for( size_t i = 0; i < keys; i++ )
+   {
+      layout.m_Keys[ i ] = m_MortonKeys[ i ].first;
+      layout.m_Particles[ i ] = m_MortonKeys[ i ].second;
+   }
+
+   layout.m_Nodes.resize( 3 * nodes );
+   layout.m_Bounds.resize( 3 * nodes );
+   for( size_t i = 0; i < nodes; i++ )
+   {
+      const Node& node = m_Nodes[ i ];
+      layout.m_Nodes[ 3 * i ] = node.m_FirstChild;
+      layout.m_Nodes[ 3 * i + 1 ] = node.m_Body;
+      layout.m_Nodes[ 3 * i + 2 ] = static_cast<int32_t>( node.m_TotalParticles );
+      layout.m_Bounds[ 3 * i ] = node.m_MinX;
+      layout.m_Bounds[ 3 * i + 1 ] = node.m_MinY;
+      layout.m_Bounds[ 3 * i + 2 ] = node.m_Size;
+   }
+
+   if( nodes == 0 )
+      layout.m_Dropped.clear();
+   else
+      layout.m_Dropped.assign( m_Dropped.begin(), m_Dropped.end() );
+   layout.m_Bodies = nodes == 0 ? 0 : static_cast<uint32_t>( m_BodyX.size() );
+   layout.m_FramesSinceRebuild = m_FramesSinceRebuild;
+}
+
+void QuadTree::setLayout( const Layout& layout )
+{
+   m_Leaves.clear();
+   m_FramesSinceRebuild = layout.m_FramesSinceRebuild;
+   if( layout.m_Nodes.empty() ) return;
+
+   m_MortonKeys.resize( layout.m_Keys.size() );
+   for( size_t i = 0; i < m_MortonKeys.size(); i++ )
+      m_MortonKeys[ i ] = { layout.m_Keys[ i ], layout.m_Particles[ i ] };
+
+   m_Nodes.clear();
+   m_Nodes.grow_by( layout.m_Nodes.size() / 3 );
+   for( size_t i = 0; i < m_Nodes.size(); i++ )
+   {
+      Node& node = m_Nodes[ i ];
+      node.m_FirstChild = layout.m_Nodes[ 3 * i ];
+      node.m_Body = layout.m_Nodes[ 3 * i + 1 ];
+      node.m_TotalParticles = static_cast<unsigned>( layout.m_Nodes[ 3 * i + 2 ] );
+      node.m_MinX = layout.m_Bounds[ 3 * i ];
+      node.m_MinY = layout.m_Bounds[ 3 * i + 1 ];
+      node.m_Size = layout.m_Bounds[ 3 * i + 2 ];
+   }
+
+   m_Dropped.clear();
+   for( int particle : layout.m_Dropped ) m_Dropped.push_back( particle );
+
+   m_BodyX.resize( layout.m_Bodies );
+   m_BodyY.resize( layout.m_Bodies );
+   m_BodyMass.resize( layout.m_Bodies );
+   collectLeaves();
+}
+
+bool QuadTree::isValid( const Layout& layout, size_t particles )
+{
+   if( layout.m_Nodes.empty() )
+      return layout.m_Keys.empty() && layout.m_Particles.empty() && layout.m_Bounds.empty() && layout.m_Dropped.empty() && layout.m_Bodies == 0;
+
+   const size_t nodes = layout.m_Nodes.size() / 3;
+   if( layout.m_Keys.size() != particles || layout.m_Particles.size() != particles || layout.m_Nodes.size() % 3 != 0 ||
+       layout.m_Bounds.size() != layout.m_Nodes.size() || layout.m_Dropped.size() > particles || layout.m_Bodies > particles ||
+       nodes > static_cast<size_t>( INT_MAX ) )
+      return false;
+
+   const auto isParticle = [ particles ]( int32_t particle ) { return particle >= 0 && static_cast<size_t>( particle ) < particles; };
+   if( !std::all_of( layout.m_Particles.begin(), layout.m_Particles.end(), isParticle ) ||
+       !std::all_of( layout.m_Dropped.begin(), layout.m_Dropped.end(), isParticle ) ||
+       !std::all_of( layout.m_Bounds.begin(), layout.m_Bounds.end(), []( float bound ) { return std::isfinite( bound ); } ) )
+      return false;
+
+   // Every reachable node has a single parent which comes before it, nodes left behind by a merge are not reachable
+   std::vector<uint8_t> reached( nodes, 0 );
+   std::vector<int> stack{ ROOT };
+   while( !stack.empty() )
+   {
+      const int node = stack.back();
+      stack.pop_back();
+
+      const int32_t firstChild = layout.m_Nodes[ 3 * node ];
+      const int32_t body = layout.m_Nodes[ 3 * node + 1 ];
+      const int32_t total = layout.m_Nodes[ 3 * node + 2 ];
+      if( total < 0 ) return false;
+
+      if( firstChild == EMPTY )
+      {
+         if( total > 0 && ( body < 0 || static_cast<size_t>( body ) + total > layout.m_Bodies ) ) return false;
+         continue;
+      }
+
+      if( firstChild <= node || static_cast<size_t>( firstChild ) + 4 > nodes ) return false;
+      for( int child = firstChild; child < firstChild + 4; child++ )
+      {
+         if( reached[ child ] ) return false;
+         reached[ child ] = 1;
+         stack.push_back( child );
+      }
+   }
+   return true;
+}
+
+void QuadTree::copyBody( size_t body )
+{
+   const int particle = m_MortonKeys[ body ].second;
+   m_BodyX[ body ] = m_Universe->m_X[ particle ];
+   m_BodyY[ body ] = m_Universe->m_Y[ particle ];
+   m_BodyMass[ body ] = m_Universe->m_Mass[ particle ];
+}
+
+unsigned QuadTree::buildMortonRange( int index, size_t begin, size_t end, int level )
+{
+   Node& node = m_Nodes[ index ];
+
+   // Past the last level the keys are identical which means the particles are colliding
+   if( end - begin <= LEAF_CAPACITY || level == MORTON_LEVELS )
+      return makeLeaf( node, begin, end );
+
+   const int firstChild = makeChildDistricts( node );
+   node.m_FirstChild = firstChild;
+
+   const int shift = 2 * ( MORTON_LEVELS - 1 - level );
+   unsigned kept[ 4 ] = { 0, 0, 0, 0 };
+   tbb::task_group g;
+   size_t digitBegin = begin;
+   for( uint64_t digit = 0; digit < 4; digit++ )
+   {
+      const size_t digitEnd = std::partition_point( m_MortonKeys.begin() + digitBegin, m_MortonKeys.begin() + end,
+                                                    [ shift, digit ]( const std::pair<uint64_t, int>& key ) { return ( ( key.first >> shift ) & 3 ) <= digit; } )
+                              - m_MortonKeys.begin();
+      if( digitEnd == digitBegin ) continue;
+
+      const int child = firstChild + DIGIT_TO_DISTRICT[ digit ];
+      unsigned* out = &kept[ digit ];
+      if( digitEnd - digitBegin > MORTON_GRAIN_SIZE )
+         g.run( [ this, child, digitBegin, digitEnd, level, out ] { *out = buildMortonRange( child, digitBegin, digitEnd, level + 1 ); } );
+      else
+         *out = buildMortonRange( child, digitBegin, digitEnd, level + 1 );
+
+      digitBegin = digitEnd;
+   }
+   g.wait();
+
+   node.m_TotalParticles = kept[ 0 ] + kept[ 1 ] + kept[ 2 ] + kept[ 3 ];
+   return node.m_TotalParticles;
+}
+
+unsigned QuadTree::makeLeaf( Node& node, size_t begin, size_t end )
+{
+   // Colliding particles are swapped past the end of the leaf so they are dropped for this frame
+   for( size_t incoming = begin + 1; incoming < end; )
+   {
+      size_t resident = begin;
+      while( resident < incoming &&
+             glm::length( glm::vec2{ m_BodyX[ incoming ] - m_BodyX[ resident ], m_BodyY[ incoming ] - m_BodyY[ resident ] } ) >= TOO_CLOSE )
+         resident++;
+
+      if( resident == incoming )
+      {
+         incoming++;
+         continue;
+      }
+
+      collide( m_MortonKeys[ resident ].second, m_MortonKeys[ incoming ].second );
+      m_BodyMass[ resident ] = m_Universe->m_Mass[ m_MortonKeys[ resident ].second ];
+      m_Dropped.push_back( m_MortonKeys[ incoming ].second );
+
+      end--;
+      std::swap( m_MortonKeys[ incoming ], m_MortonKeys[ end ] );
+      std::swap( m_BodyX[ incoming ], m_BodyX[ end ] );
+      std::swap( m_BodyY[ incoming ], m_BodyY[ end ] );
+      std::swap( m_BodyMass[ incoming ], m_BodyMass[ end ] );
+   }
+
+   node.m_Body = static_cast<int>( begin );
+   node.m_TotalParticles = static_cast<unsigned>( end - begin );
+   return node.m_TotalParticles;
+}
+
+uint64_t QuadTree::calcMortonKey( const glm::vec2& pos ) const
+{
+   static constexpr const double CELLS = static_cast<double>( 1u << MORTON_LEVELS );
+
+   const auto quantize = [ this ]( float value, float min ) -> uint64_t
+   {
+      const double cell = ( static_cast<double>( value ) - min ) / m_Size * CELLS;
+      return static_cast<uint64_t>( std::min( std::max( cell, 0.0 ), CELLS - 1.0 ) );
+   };
+
+   // Spread the bits so x lands on the even bits and y on the odd ones
+   const auto spread = []( uint64_t v ) -> uint64_t
+   {
+      v = ( v | ( v << 16 ) ) & 0x0000FFFF0000FFFFull;
+      v = ( v | ( v << 8 ) ) & 0x00FF00FF00FF00FFull;
+      v = ( v | ( v << 4 ) ) & 0x0F0F0F0F0F0F0F0Full;
+      v = ( v | ( v << 2 ) ) & 0x3333333333333333ull;
+      v = ( v | ( v << 1 ) ) & 0x5555555555555555ull;
+      return v;
+   };
+
+   return spread( quantize( pos.x, m_MinX ) ) | ( spread( quantize( pos.y, m_MinY ) ) << 1 );
+}
+
+void QuadTree::collide( size_t resident, size_t incoming )
+{
+   Universe& universe = *m_Universe;
+   if( universe.m_Color[ incoming ] != ObjectColors::YELLOW )
+   {
+      static constexpr const long double PI = 3.141592653589793238462643383279502884L;
+
+      // Substream 0 belongs to Galaxy::Build, frames start at 1
+      Random::Stream gen( m_Seed, incoming, m_Frame );
+
+      const auto angle = static_cast<float>( gen.lognormal( 0.0, 1.8645 ) * 2.0L * PI );
+      const auto travel = static_cast<float>( sqrt( gen.lognormal( 0.0, 1.8645 ) * 1.8987654f ) );
+
+      // in Cartesian coordinates
+      const float rel_x = travel * cos( angle );
+      const float rel_y = travel * sin( angle );
+
+
+      const float distance = sqrt( rel_x * rel_x + rel_y * rel_y );
+
+      if( distance <= 1.8987654f )
+      {
+         universe.m_X[ incoming ] += rel_x;
+         universe.m_Y[ incoming ] += rel_y;
+
+         const float force_ratio = distance / 1.8987654f;
+         universe.m_Mass[ resident ] += ( universe.m_Mass[ incoming ] * force_ratio );
+         universe.m_Mass[ incoming ] = universe.m_Mass[ incoming ] * ( 1.0f - force_ratio );
+      }
+      else
+      {
+         universe.setPos( incoming, { -1000.0f, -1000.0f } );
+         universe.m_Mass[ resident ] += universe.m_Mass[ incoming ] / 2.0f;
+      }
+   }
+}
+
+glm::vec2 QuadTree::calcForce( size_t particle ) const
+{
+   const glm::vec2 pos = m_Universe->getPos( particle );
+   glm::vec2 acc{ 0.0f, 0.0f };
+   size_t interactions = 0;
+
+   const int end = static_cast<int>( m_Cells.size() );
+   for( int index = 0; index < end; )
+   {
+      const Cell& cell = m_Cells[ index ];
+
+      const float dx = pos.x - cell.m_CenterOfMass.x;
+      const float dy = pos.y - cell.m_CenterOfMass.y;
+      const float r2 = dx * dx + dy * dy;
+
+      if( r2 > cell.m_OpeningRadius2 ) // same as d / r < theta without the square root
+      {
+         const glm::vec3& q = cell.m_Quadrupole;
+         Gravity::expand( pos.x, pos.y, cell.m_CenterOfMass.x, cell.m_CenterOfMass.y, cell.m_Mass, q.x, q.y, q.z, acc.x, acc.y );
+         interactions++;
+         index = cell.m_Next;
+      }
+      else if( cell.m_Body != EMPTY )
+      {
+         Gravity::accumulate( pos.x, pos.y, &m_BodyX[ cell.m_Body ], &m_BodyY[ cell.m_Body ], &m_BodyMass[ cell.m_Body ],
+                              cell.m_TotalParticles, acc.x, acc.y );
+         interactions += cell.m_TotalParticles;
+         index = cell.m_Next;
+      }
+      else
+      {
+         index++; // open the cell
+      }
+   }
+
+   m_Interactions.local() += interactions;
+   return acc;
+}
+
+template<typename Visit>
+void QuadTree::walkGroup( const glm::vec2& min, const glm::vec2& max, const Visit& visit ) const
+{
+   // A cell is accepted only if it passes the opening test for every point of the group's bounding box
+   const int end = static_cast<int>( m_Cells.size() );
+   for( int index = 0; index < end; )
+   {
+      const Cell& cell = m_Cells[ index ];
+
+      const float dx = std::max( { min.x - cell.m_CenterOfMass.x, 0.0f, cell.m_CenterOfMass.x - max.x } );
+      const float dy = std::max( { min.y - cell.m_CenterOfMass.y, 0.0f, cell.m_CenterOfMass.y - max.y } );
+
+      if( dx * dx + dy * dy > cell.m_OpeningRadius2 )
+      {
+         visit( cell, true );
+         index = cell.m_Next;
+      }
+      else if( cell.m_Body != EMPTY )
+      {
+         visit( cell, false );
+         index = cell.m_Next;
+      }
+      else
+      {
+         index++; // open the cell
+      }
+   }
+}
+
+void QuadTree::calcBounds( const std::vector<int>& members, glm::vec2& min, glm::vec2& max ) const
+{
+   min = m_Universe->getPos( members.front() );
+   max = min;
+   for( int particle : members )
+   {
+      const glm::vec2 pos = m_Universe->getPos( particle );
+      min = { std::min( min.x, pos.x ), std::min( min.y, pos.y ) };
+      max = { std::max( max.x, pos.x ), std::max( max.y, pos.y ) };
+   }
+}
+
+void QuadTree::calcGroupForces( const std::vector<uint8_t>& active, float* acc_x, float* acc_y ) const
+{
+   tbb::parallel_for(
+      tbb::blocked_range<size_t>( 0, m_Groups.size() ),
+      [ this, &active, acc_x, acc_y ]( const tbb::blocked_range<size_t>& range )
+      {
+         InteractionList& list = m_InteractionLists.local();
+         for( size_t i = range.begin(); i < range.end(); i++ )
+            calcGroupForces( m_Groups[ i ], list, active, acc_x, acc_y );
+      }
+   );
+
+   tbb::parallel_for(
+      tbb::blocked_range<size_t>( 0, m_Dropped.size() ),
+      [ this, &active, acc_x, acc_y ]( const tbb::blocked_range<size_t>& range )
+      {
+         for( size_t i = range.begin(); i < range.end(); i++ )
+         {
+            const int particle = m_Dropped[ i ];
+            if( !active[ particle ] ) continue;
+
+            const glm::vec2 acc = calcForce( particle );
+            acc_x[ particle ] = acc.x;
+            acc_y[ particle ] = acc.y;
+         }
+      }
+   );
+}
+
+void QuadTree::calcGroupForces( int group, InteractionList& list, const std::vector<uint8_t>& active, float* acc_x, float* acc_y ) const
+{
+   const int groupEnd = m_Cells[ group ].m_Next;
+
+   list.m_Members.clear();
+   for( int index = group; index < groupEnd; index++ )
+   {
+      const Cell& cell = m_Cells[ index ];
+      if( cell.m_Body == EMPTY ) continue;
+
+      for( int body = cell.m_Body; body < cell.m_Body + static_cast<int>( cell.m_TotalParticles ); body++ )
+         if( active[ m_MortonKeys[ body ].second ] )
+            list.m_Members.push_back( m_MortonKeys[ body ].second );
+   }
+
+   // The bounding box only covers the active members so a sparse group accepts more cells
+   if( list.m_Members.empty() ) return;
+
+   glm::vec2 min, max;
+   calcBounds( list.m_Members, min, max );
+
+   list.clear();
+   walkGroup( min, max, [ this, &list ]( const Cell& cell, bool accepted )
+   {
+      if( accepted )
+         list.push( cell );
+      else
+         for( int body = cell.m_Body; body < cell.m_Body + static_cast<int>( cell.m_TotalParticles ); body++ )
+            list.push( m_BodyX[ body ], m_BodyY[ body ], m_BodyMass[ body ] );
+   } );
+
+   m_Interactions.local() += ( list.m_X.size() + list.m_CellX.size() ) * list.m_Members.size();
+   for( int particle : list.m_Members )
+   {
+      const float x = m_Universe->m_X[ particle ];
+      const float y = m_Universe->m_Y[ particle ];
+      acc_x[ particle ] = 0.0f;
+      acc_y[ particle ] = 0.0f;
+      Gravity::accumulateExpansions( x, y, list.m_CellX.data(), list.m_CellY.data(), list.m_CellMass.data(), list.m_CellXX.data(),
+                                     list.m_CellXY.data(), list.m_CellYY.data(), list.m_CellX.size(), acc_x[ particle ], acc_y[ particle ] );
+      Gravity::accumulate( x, y, list.m_X.data(), list.m_Y.data(), list.m_Mass.data(), list.m_X.size(), acc_x[ particle ], acc_y[ particle ] );
+   }
+}
+
+void QuadTree::print() const
+{
+   if( m_Nodes.empty() ) return;
+
+   const Node& root = m_Nodes[ ROOT ];
+   printf( "%u particles with a mass of %f centered at { %f, %f } in %zu nodes\r\n", root.m_TotalParticles, root.m_Mass,
+           root.m_CenterOfMass.x, root.m_CenterOfMass.y, m_Nodes.size() );
+}
+
+unsigned QuadTree::getDepth() const
+{
+   float smallest = m_Size;
+   for( const Cell& cell : m_Cells )
+      smallest = std::min( smallest, m_Nodes[ cell.m_Node ].m_Size );
+
+   return static_cast<unsigned>( std::ilogb( m_Size / smallest ) );
+}
+
+size_t QuadTree::takeInteractions()
+{
+   size_t interactions = 0;
+   for( size_t& local : m_Interactions )
+   {
+      interactions += local;
+      local = 0;
+   }
+   return interactions;
+}
+
+void QuadTree::collectOverlay( Overlay& overlay, unsigned depth, bool heatmap ) const
+{
+   static constexpr const size_t VERTICES = 8;
+
+   std::vector<unsigned> counts;
+   if( heatmap ) calcInteractionCounts( counts );
+   const float scale = heatmap && !counts.empty() ? 1.0f / std::log1p( static_cast<float>( *std::max_element( counts.begin(), counts.end() ) ) ) : 0.0f;
+
+   overlay.m_X.resize( m_Cells.size() * VERTICES );
+   overlay.m_Y.resize( m_Cells.size() * VERTICES );
+   overlay.m_Heat.resize( heatmap ? m_Cells.size() * VERTICES : 0 );
+
+   // Every range claims room for the cells it keeps with a single atomic add, the order of the cells does not matter
+   std::atomic<size_t> written{ 0 };
+   tbb::parallel_for(
+      tbb::blocked_range<size_t>( 0, m_Cells.size() ),
+      [ this, &overlay, &counts, &written, depth, heatmap, scale ]( const tbb::blocked_range<size_t>& range )
+      {
+         const auto visible = [ this, depth ]( size_t cell )
+         {
+            return std::ilogb( m_Size / m_Nodes[ m_Cells[ cell ].m_Node ].m_Size ) <= static_cast<int>( depth );
+         };
+
+         size_t kept = 0;
+         for( size_t i = range.begin(); i < range.end(); i++ )
+            kept += visible( i );
+
+         size_t vertex = written.fetch_add( kept * VERTICES );
+         for( size_t i = range.begin(); i < range.end(); i++ )
+         {
+            if( !visible( i ) ) continue;
+
+            const Node& node = m_Nodes[ m_Cells[ i ].m_Node ];
+            const float x0 = node.m_MinX, y0 = node.m_MinY, x1 = node.m_MinX + node.m_Size, y1 = node.m_MinY + node.m_Size;
+            const float xs[ VERTICES ] = { x0, x1, x1, x1, x1, x0, x0, x0 };
+            const float ys[ VERTICES ] = { y0, y0, y0, y1, y1, y1, y1, y0 };
+            const float heat = heatmap ? std::log1p( static_cast<float>( counts[ i ] ) ) * scale : 0.0f;
+
+            for( size_t v = 0; v < VERTICES; v++, vertex++ )
+            {
+               overlay.m_X[ vertex ] = xs[ v ];
+               overlay.m_Y[ vertex ] = ys[ v ];
+               if( heatmap ) overlay.m_Heat[ vertex ] = heat;
+            }
+         }
+      }
+   );
+
+   overlay.m_X.resize( written );
+   overlay.m_Y.resize( written );
+   if( heatmap ) overlay.m_Heat.resize( written );
+}
+
+void QuadTree::calcInteractionCounts( std::vector<unsigned>& counts ) const
+{
+   // Replays the group walk without the kernel, every accepted cell or opened leaf interacts with the whole group
+   tbb::enumerable_thread_specific<std::vector<unsigned>, CountedAllocator<std::vector<unsigned>>> local( m_Cells.size(), 0u );
+   tbb::parallel_for(
+      tbb::blocked_range<size_t>( 0, m_Groups.size() ),
+      [ this, &local ]( const tbb::blocked_range<size_t>& range )
+      {
+         std::vector<unsigned>& mine = local.local();
+         std::vector<int> members;
+         for( size_t i = range.begin(); i < range.end(); i++ )
+         {
+            const int group = m_Groups[ i ];
+            members.clear();
+            for( int index = group; index < m_Cells[ group ].m_Next; index++ )
+            {
+               const Cell& cell = m_Cells[ index ];
+               if( cell.m_Body == EMPTY ) continue;
+
+               for( int body = cell.m_Body; body < cell.m_Body + static_cast<int>( cell.m_TotalParticles ); body++ )
+                  members.push_back( m_MortonKeys[ body ].second );
+            }
+
+            glm::vec2 min, max;
+            calcBounds( members, min, max );
+
+            const unsigned size = static_cast<unsigned>( members.size() );
+            walkGroup( min, max, [ this, &mine, size ]( const Cell& cell, bool ) { mine[ &cell - m_Cells.data() ] += size; } );
+         }
+      }
+   );
+
+   counts.assign( m_Cells.size(), 0u );
+   for( const std::vector<unsigned>& mine : local )
+      for( size_t i = 0; i < counts.size(); i++ )
+         counts[ i ] += mine[ i ];
+}
+
+void QuadTree::calcMassDistribution()
+{
+   if( m_Nodes[ ROOT ].m_TotalParticles == 0 )
+   {
+      m_Cells.clear();
+      m_Groups.clear();
+      return;
+   }
+
+   m_Cells.resize( calcMassDistribution( ROOT ) );
+   layoutCells( ROOT, 0 );
+
+   m_Groups.clear();
+   for( int index = 0; index < static_cast<int>( m_Cells.size() ); )
+   {
+      const Cell& cell = m_Cells[ index ];
+      if( cell.m_TotalParticles <= GROUP_SIZE || cell.m_Body != EMPTY )
+      {
+         m_Groups.push_back( index );
+         index = cell.m_Next;
+      }
+      else
+         index++;
+   }
+}
+
+unsigned QuadTree::calcMassDistribution( int index )
+{
+   Node& node = m_Nodes[ index ];
+   node.m_Mass = 0.0f;
+   node.m_CenterOfMass = glm::vec2{ 0.0f, 0.0f };
+   node.m_SecondMoment = glm::vec3{ 0.0f };
+   node.m_OccupiedNodes = 1;
+
+   // Second moments are taken about this node's center of mass so they need it first
+   const auto addSecondMoment = [ &node ]( float mass, const glm::vec2& pos )
+   {
+      const glm::vec2 s = pos - node.m_CenterOfMass;
+      node.m_SecondMoment += mass * glm::vec3{ s.x * s.x, s.x * s.y, s.y * s.y };
+   };
+
+   if( node.isLeaf() )
+   {
+      for( int body = node.m_Body; body < node.m_Body + static_cast<int>( node.m_TotalParticles ); body++ )
+      {
+         node.m_Mass += m_BodyMass[ body ];
+         node.m_CenterOfMass += m_BodyMass[ body ] * glm::vec2{ m_BodyX[ body ], m_BodyY[ body ] };
+      }
+      if( node.m_Mass > 0.0f ) node.m_CenterOfMass /= node.m_Mass;
+
+      for( int body = node.m_Body; body < node.m_Body + static_cast<int>( node.m_TotalParticles ); body++ )
+         addSecondMoment( m_BodyMass[ body ], glm::vec2{ m_BodyX[ body ], m_BodyY[ body ] } );
+   }
+   else
+   {
+      tbb::task_group g;
+      for( int child = node.m_FirstChild; child < node.m_FirstChild + 4; child++ )
+      {
+         if( m_Nodes[ child ].m_TotalParticles == 0 ) continue;
+
+         g.run( [ this, child ] { calcMassDistribution( child ); } );
+      }
+      g.wait();
+
+      for( int child = node.m_FirstChild; child < node.m_FirstChild + 4; child++ )
+      {
+         const Node& quad = m_Nodes[ child ];
+         if( quad.m_TotalParticles == 0 ) continue;
+
+         node.m_Mass += quad.m_Mass;
+         node.m_CenterOfMass += quad.m_Mass * quad.m_CenterOfMass;
+         node.m_OccupiedNodes += quad.m_OccupiedNodes;
+      }
+      if( node.m_Mass > 0.0f ) node.m_CenterOfMass /= node.m_Mass;
+
+      // Parallel axis theorem moves each child's moment onto this center of mass
+      for( int child = node.m_FirstChild; child < node.m_FirstChild + 4; child++ )
+      {
+         const Node& quad = m_Nodes[ child ];
+         if( quad.m_TotalParticles == 0 ) continue;
+
+         node.m_SecondMoment += quad.m_SecondMoment;
+         addSecondMoment( quad.m_Mass, quad.m_CenterOfMass );
+      }
+   }
+
+   return node.m_OccupiedNodes;
+}
+
+void QuadTree::layoutCells( int index, int position )
+{
+   const Node& node = m_Nodes[ index ];
+   const glm::vec3& moment = node.m_SecondMoment;
+   const float trace = moment.x + moment.z;
+
+   // The radius is measured from the center of mass, its offset from the box's center is added so no point of the box
+   // ( a particle in the cell or a group overlapping it ) accepts the cell and pulls on itself, whatever theta
+   const glm::vec2 center{ node.m_MinX + node.m_Size / 2.0f, node.m_MinY + node.m_Size / 2.0f };
+   const float radius = std::max( node.m_Size / m_Theta, node.m_Size * HALF_DIAGONAL ) + glm::length( node.m_CenterOfMass - center );
+   m_Cells[ position ] = { node.m_CenterOfMass, node.m_Mass, radius * radius, position + static_cast<int>( node.m_OccupiedNodes ),
+                           node.isLeaf() ? node.m_Body : EMPTY, node.m_TotalParticles,
+                           glm::vec3{ 3.0f * moment.x - trace, 3.0f * moment.y, 3.0f * moment.z - trace }, index };
+
+   if( node.isLeaf() ) return;
+
+   tbb::task_group g;
+   int childPosition = position + 1;
+   for( int child = node.m_FirstChild; child < node.m_FirstChild + 4; child++ )
+   {
+      const Node& quad = m_Nodes[ child ];
+      if( quad.m_TotalParticles == 0 ) continue;
+
+      if( quad.m_OccupiedNodes > LAYOUT_GRAIN_SIZE )
+         g.run( [ this, child, childPosition ] { layoutCells( child, childPosition ); } );
+      else
+         layoutCells( child, childPosition );
+
+      childPosition += quad.m_OccupiedNodes;
+   }
+   g.wait();
+}
+
+int QuadTree::makeChildDistricts( const Node& parent )
+{
+   const auto first = m_Nodes.grow_by( 4 );
+   const float half = parent.m_Size / 2.0f;
+
+   first[ NE ].m_MinX = parent.m_MinX + half; first[ NE ].m_MinY = parent.m_MinY + half;
+   first[ SE ].m_MinX = parent.m_MinX + half; first[ SE ].m_MinY = parent.m_MinY;
+   first[ SW ].m_MinX = parent.m_MinX;        first[ SW ].m_MinY = parent.m_MinY;
+   first[ NW ].m_MinX = parent.m_MinX;        first[ NW ].m_MinY = parent.m_MinY + half;
+   for( int i = NE; i <= NW; i++ ) first[ i ].m_Size = half;
+
+   return static_cast<int>( first - m_Nodes.begin() );
+}
+
+bool QuadTree::outsideOfRegion( const Node& node, const glm::vec2& pos ) const
+{
+   return !( pos.x >= node.m_MinX && pos.x <= node.m_MinX + node.m_Size &&
+             pos.y >= node.m_MinY && pos.y <= node.m_MinY + node.m_Size );
+}
+
+QuadTree::District QuadTree::Node::determineChildDistrict( const glm::vec2& pos ) const
+{
+   const float half = m_Size / 2.0f;
+   const bool east = pos.x >= m_MinX + half;
+   const bool north = pos.y >= m_MinY + half;
+
+   if( east ) return north ? NE : SE;
+   return north ? NW : SW;
+}
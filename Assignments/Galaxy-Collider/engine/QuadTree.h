@@ -0,0 +1,258 @@
+/*
+MIT License
+
+Copyright (c) 2018 Chris McArthur, prince.chrismc(at)gmail(dot)com
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+#pragma once
+
+#include "Universe.h"
+#include "glm/vec3.hpp"
+#include "tbb/concurrent_vector.h"
+#include "tbb/enumerable_thread_specific.h"
+#include "tbb/spin_mutex.h"
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+class QuadTree
+{
+public:
+   enum District { NE, SE, SW, NW };
+
+   // The root is the square from { x_min, y_min } to { x_min + size, y_min + size }
+   QuadTree( float x_min, float y_min, float size );
+
+   void build( Universe& universe, size_t particles );
+   void buildMorton( Universe& universe, size_t particles );
+
+   // Keeps the previous frame's tree and only relocates the particles which left their leaf, falls back to buildMorton
+   // every REBUILD_INTERVAL frames or when too many particles moved
+   void update( Universe& universe, size_t particles );
+
+   // Structure of the tree after the last update, enough for the next update to refit or rebuild exactly when this tree
+   // would have. The copies of the bodies and the mass distribution are redone by every update so they are left out
+   struct Layout
+   {
+      std::vector<uint64_t> m_Keys;
+      std::vector<int32_t> m_Particles;   // of every key
+      std::vector<int32_t> m_Nodes;       // first child, first body and particles of every node
+      std::vector<float> m_Bounds;        // min x, min y and size of every node
+      std::vector<int32_t> m_Dropped;
+      uint32_t m_Bodies{ 0 };
+      uint32_t m_FramesSinceRebuild{ 0 };
+   };
+   void getLayout( Layout& layout ) const;   // empty before the first update
+   void setLayout( const Layout& layout );
+
+   // Whether a layout read from outside can be set on a tree of `particles`, every node reachable from the root is checked
+   static bool isValid( const Layout& layout, size_t particles );
+
+   void calcMassDistribution();
+   glm::vec2 calcForce( size_t particle ) const;   // monopole and quadrupole of every accepted cell
+   void print() const;
+
+   // For the profiler, the depth is the number of levels below the root
+   size_t getNodeCount() const { return m_Nodes.size(); }
+   unsigned getDepth() const;
+
+   // Cells and bodies the force walks interacted with since the last call
+   size_t takeInteractions();
+
+   // Collisions scatter particles with random numbers drawn from this seed, the frame and the particle
+   void setSeed( uint64_t seed ) { m_Seed = seed; }
+
+   // Frames updated so far, restored along with the seed so a resumed run draws the collisions it would have drawn
+   uint32_t getFrame() const { return m_Frame; }
+   void setFrame( uint32_t frame ) { m_Frame = frame; }
+
+   // Opening angle, takes effect with the next calcMassDistribution
+   void setTheta( float theta ) { m_Theta = theta; }
+   float getTheta() const { return m_Theta; }
+
+   // Walks the tree once per group of nearby particles and evaluates the shared interaction list for each of its members
+   // flagged in `active`, groups without any active member are skipped. The accelerations are stored by particle index
+   void calcGroupForces( const std::vector<uint8_t>& active, float* acc_x, float* acc_y ) const;
+
+   // Neighbouring ranks are close in space so walking the particles in this order mostly visits the same cells
+   size_t getParticleInTreeOrder( size_t rank ) const { return m_MortonKeys[ rank ].second; }
+
+   // Compact node, children are allocated as a block of four consecutive nodes
+   struct Node
+   {
+      glm::vec2 m_CenterOfMass{ 0.0f };
+      float m_Mass{ 0.0f };
+      glm::vec3 m_SecondMoment{ 0.0f };   // { xx, xy, yy } of sum m s s^T about the center of mass
+
+      float m_MinX{ 0.0f };
+      float m_MinY{ 0.0f };
+      float m_Size{ 0.0f };
+
+      int m_FirstChild{ EMPTY };  // index of the NE child
+      int m_Body{ EMPTY };        // first of the leaf's m_TotalParticles bodies
+      unsigned m_TotalParticles{ 0 };
+      unsigned m_OccupiedNodes{ 0 };  // in this subtree, including itself
+
+      tbb::spin_mutex m_InsertLock;
+
+      bool isLeaf() const { return m_FirstChild == EMPTY; }
+      District determineChildDistrict( const glm::vec2& pos ) const;
+   };
+
+   // Depth first copy of the occupied nodes for the force walk, a cell's first child follows it and m_Next skips its subtree
+   struct alignas( 64 ) Cell
+   {
+      glm::vec2 m_CenterOfMass;
+      float m_Mass;
+      float m_OpeningRadius2;     // ( size / theta + offset of the center of mass )^2, anything further away uses the expansion
+      int m_Next;
+      int m_Body;                 // EMPTY unless this is a leaf
+      unsigned m_TotalParticles;
+      glm::vec3 m_Quadrupole;     // traceless { xx, xy, yy } of sum m ( 3 s s^T - |s|^2 I )
+      int m_Node;                 // the node it was copied from, fits in the padding
+   };
+
+   // Outlines of the occupied cells down to a depth below the root as GL_LINES vertices, eight per cell. With the heatmap
+   // every vertex carries how many particles interact with its cell in the group walk, log scaled to [ 0, 1 ]
+   struct Overlay
+   {
+      Universe::Column<float> m_X;
+      Universe::Column<float> m_Y;
+      Universe::Column<float> m_Heat;   // empty without the heatmap
+   };
+   void collectOverlay( Overlay& overlay, unsigned depth, bool heatmap ) const;
+
+   static constexpr const int EMPTY = -1;
+   static constexpr const int ROOT = 0;
+   static constexpr const float DEFAULT_THETA = 0.9f;
+
+private:
+   friend class FastMultipole;
+
+   // Nodes are reset and not freed between frames so rebuilding the tree does not allocate once warmed up
+   tbb::concurrent_vector<Node, CountedAllocator<Node>> m_Nodes;
+   Universe* m_Universe;
+
+   float m_MinX;
+   float m_MinY;
+   float m_Size;
+
+   // ( Z-order key, particle index ) sorted so every quadrant covers a contiguous range
+   std::vector<std::pair<uint64_t, int>> m_MortonKeys;
+
+   // Copy of the particles in tree order so a leaf's bodies are contiguous for the force kernel
+   Universe::Column<float> m_BodyX;
+   Universe::Column<float> m_BodyY;
+   Universe::Column<float> m_BodyMass;
+
+   std::vector<Cell> m_Cells;
+
+   // Leaves in Morton order ( including the empty ones ) and each node's position in that list, for update
+   std::vector<int> m_Leaves;
+   std::vector<int> m_LeafOrder;
+   unsigned m_FramesSinceRebuild{ 0 };
+
+   // Scratch space for update, kept between frames
+   tbb::concurrent_vector<int, CountedAllocator<int>> m_Escaped;
+   std::vector<std::pair<int, int>> m_Movers;         // ( leaf order, particle )
+   std::vector<size_t> m_LeafOffsets;
+   std::vector<std::pair<uint64_t, int>> m_RefitKeys;
+
+   // Highest cells with at most GROUP_SIZE particles and the particles which did not make it into the tree
+   std::vector<int> m_Groups;
+   tbb::concurrent_vector<int, CountedAllocator<int>> m_Dropped;
+
+   // Bodies of the opened leaves and the accepted cells a group interacts with, reused between groups
+   struct InteractionList
+   {
+      Universe::Column<float> m_X;
+      Universe::Column<float> m_Y;
+      Universe::Column<float> m_Mass;
+      Universe::Column<float> m_CellX;   // accepted cells, expanded with their quadrupole like in calcForce
+      Universe::Column<float> m_CellY;
+      Universe::Column<float> m_CellMass;
+      Universe::Column<float> m_CellXX;
+      Universe::Column<float> m_CellXY;
+      Universe::Column<float> m_CellYY;
+      std::vector<int> m_Members;
+
+      void clear()
+      {
+         m_X.clear(); m_Y.clear(); m_Mass.clear();
+         m_CellX.clear(); m_CellY.clear(); m_CellMass.clear(); m_CellXX.clear(); m_CellXY.clear(); m_CellYY.clear();
+      }
+      void push( float x, float y, float m ) { m_X.push_back( x ); m_Y.push_back( y ); m_Mass.push_back( m ); }
+      void push( const Cell& cell )
+      {
+         m_CellX.push_back( cell.m_CenterOfMass.x ); m_CellY.push_back( cell.m_CenterOfMass.y ); m_CellMass.push_back( cell.m_Mass );
+         m_CellXX.push_back( cell.m_Quadrupole.x ); m_CellXY.push_back( cell.m_Quadrupole.y ); m_CellYY.push_back( cell.m_Quadrupole.z );
+      }
+   };
+   mutable tbb::enumerable_thread_specific<InteractionList, CountedAllocator<InteractionList>> m_InteractionLists;
+   mutable tbb::enumerable_thread_specific<size_t, CountedAllocator<size_t>> m_Interactions;
+
+   float m_Theta{ DEFAULT_THETA };
+   uint64_t m_Seed{ 0 };
+   uint32_t m_Frame{ 0 };
+
+   static constexpr const float TOO_CLOSE = 0.00000125f;
+   static constexpr const float HALF_DIAGONAL = 0.7072f;   // of a unit square, rounded up
+
+   static constexpr const int MORTON_LEVELS = 31;
+   static constexpr const uint64_t OUTSIDE_OF_REGION = UINT64_MAX;
+   static constexpr const size_t MORTON_GRAIN_SIZE = 1024;
+   static constexpr const size_t LEAF_CAPACITY = 8;
+   static constexpr const unsigned LAYOUT_GRAIN_SIZE = 4096;
+   static constexpr const unsigned GROUP_SIZE = 32;
+   static constexpr const unsigned REBUILD_INTERVAL = 16;
+   static constexpr const size_t REFIT_LIMIT = 16;     // rebuild if more than 1 / REFIT_LIMIT of the particles moved
+
+   // Z-order digits are SW, SE, NW, NE ( y is the high bit )
+   static constexpr const District DIGIT_TO_DISTRICT[ 4 ] = { SW, SE, NW, NE };
+
+   void reset( Universe& universe, size_t bodies );
+   void insert( int node, int particle );
+   unsigned buildMortonRange( int node, size_t begin, size_t end, int level );
+   unsigned makeLeaf( Node& node, size_t begin, size_t end );
+   uint64_t calcMortonKey( const glm::vec2& pos ) const;
+
+   void copyBody( size_t body );
+
+   void collectLeaves();
+   void collectLeaves( int node );
+   bool refit( size_t particles );
+   unsigned refitNode( int node, int level );
+   void collide( size_t resident, size_t incoming );
+
+   int makeChildDistricts( const Node& parent );
+   bool outsideOfRegion( const Node& node, const glm::vec2& pos ) const;
+
+   unsigned calcMassDistribution( int node );
+   void layoutCells( int node, int cell );
+   void calcGroupForces( int group, InteractionList& list, const std::vector<uint8_t>& active, float* acc_x, float* acc_y ) const;
+
+   // Visits the cells accepted by the box { min, max } and the leaves it opens, `visit( cell, accepted )`
+   template<typename Visit>
+   void walkGroup( const glm::vec2& min, const glm::vec2& max, const Visit& visit ) const;
+   void calcBounds( const std::vector<int>& members, glm::vec2& min, glm::vec2& max ) const;
+   void calcInteractionCounts( std::vector<unsigned>& counts ) const;
+};
@@ -0,0 +1,105 @@
+/*
+MIT License
+
+Copyright (c) 2018 Chris McArthur, prince.chrismc(at)gmail(dot)com
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+#pragma once
+
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <random>
+
+// Counter based random numbers ( Philox4x32-10 ), the output only depends on the seed and the counter so every particle
+// owns an independent stream and the result does not depend on which thread or in which order it is drawn
+namespace Random
+{
+   // Non reproducible seed for when the user did not pick one
+   inline uint64_t makeSeed()
+   {
+      std::random_device rd;
+      return ( static_cast<uint64_t>( rd() ) << 32 ) | rd();
+   }
+
+   class Stream
+   {
+   public:
+      Stream( uint64_t seed, uint64_t stream, uint32_t substream = 0 ) :
+         m_Key{ { static_cast<uint32_t>( seed ), static_cast<uint32_t>( seed >> 32 ) } },
+         m_Counter{ { 0, substream, static_cast<uint32_t>( stream ), static_cast<uint32_t>( stream >> 32 ) } }
+      {
+      }
+
+      uint32_t next()
+      {
+         if( m_Used == 4 )
+         {
+            m_Block = philox( m_Counter, m_Key );
+            m_Counter[ 0 ]++;
+            m_Used = 0;
+         }
+         return m_Block[ m_Used++ ];
+      }
+
+      // In ( 0, 1 ] so it is safe to take the log of
+      double uniform()
+      {
+         const uint64_t bits = ( static_cast<uint64_t>( next() ) << 32 ) | next();
+         return ( ( bits >> 11 ) + 1 ) * ( 1.0 / 9007199254740992.0 );
+      }
+
+      // Box-Muller, the second value is dropped so the count of words per draw stays fixed
+      double normal()
+      {
+         static constexpr const double TWO_PI = 6.283185307179586476925286766559;
+
+         const double u1 = uniform();
+         const double u2 = uniform();
+         return std::sqrt( -2.0 * std::log( u1 ) ) * std::cos( TWO_PI * u2 );
+      }
+
+      double lognormal( double m, double s ) { return std::exp( m + s * normal() ); }
+
+      static std::array<uint32_t, 4> philox( std::array<uint32_t, 4> counter, std::array<uint32_t, 2> key )
+      {
+         for( int round = 0; round < 10; round++ )
+         {
+            const uint64_t a = static_cast<uint64_t>( 0xD2511F53u ) * counter[ 0 ];
+            const uint64_t b = static_cast<uint64_t>( 0xCD9E8D57u ) * counter[ 2 ];
+
+            counter = { { static_cast<uint32_t>( b >> 32 ) ^ counter[ 1 ] ^ key[ 0 ], static_cast<uint32_t>( b ),
+                          static_cast<uint32_t>( a >> 32 ) ^ counter[ 3 ] ^ key[ 1 ], static_cast<uint32_t>( a ) } };
+
+            key[ 0 ] += 0x9E3779B9u;
+            key[ 1 ] += 0xBB67AE85u;
+         }
+         return counter;
+      }
+
+   private:
+      std::array<uint32_t, 2> m_Key;
+      std::array<uint32_t, 4> m_Counter;
+      std::array<uint32_t, 4> m_Block{};
+      int m_Used{ 4 };
+   };
+}
@@ -0,0 +1,172 @@
+/*
+MIT License
+
+Copyright (c) 2018 Chris McArthur, prince.chrismc(at)gmail(dot)com
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+#include "Simulation.h"
+
+static_assert( static_cast<uint32_t>( Simulation::Solver::FAST_MULTIPOLE ) + 1 == Snapshot::SOLVERS, "Snapshot::load checks the solver against SOLVERS" );
+
+Simulation::Simulation( size_t particles, uint64_t seed ) : m_Seed( seed ), m_Tree( -BOUNDARY, -BOUNDARY, 2.0f * BOUNDARY ), m_Solver( Solver::BARNES_HUT )
+{
+   // The prime galaxy gets 35 / 43 of the stars, the default is 3500 and 800
+   const size_t prime = particles * 35 / 43;
+   Galaxy::Build( m_Universe, ObjectColors::RED, 5.0f, -4.0f, 0.75f, prime, false, seed );
+   Galaxy::Build( m_Universe, ObjectColors::GREEN, -4.0f, 3.0f, 0.35f, particles - prime, true, seed );
+   m_NumParticles = m_Universe.size();
+
+   m_Tree.setSeed( seed );
+}
+
+Simulation::Simulation( Snapshot&& snapshot ) : m_Universe( std::move( snapshot.m_Universe ) ), m_Seed( snapshot.m_Seed ),
+   m_NumParticles( snapshot.m_NumParticles ), m_Steps( snapshot.m_Steps ), m_Tree( -BOUNDARY, -BOUNDARY, 2.0f * BOUNDARY ),
+   m_Solver( static_cast<Solver>( snapshot.m_Solver ) )
+{
+   m_Tree.setSeed( m_Seed );
+   m_Tree.setFrame( snapshot.m_Frame );
+   m_Tree.setTheta( snapshot.m_Theta );
+   m_Tree.setLayout( snapshot.m_Tree );
+
+   m_Integrator.setTimestep( snapshot.m_Timestep );
+   m_Integrator.setAdaptive( snapshot.m_Adaptive );
+   m_Integrator.restore( snapshot.m_Rungs, snapshot.m_ForceEvaluations );
+}
+
+void Simulation::Save( Snapshot& snapshot ) const
+{
+   // assign keeps the capacity so a recycled snapshot does not allocate
+   Universe& universe = snapshot.m_Universe;
+   universe.m_X.assign( m_Universe.m_X.begin(), m_Universe.m_X.end() );
+   universe.m_Y.assign( m_Universe.m_Y.begin(), m_Universe.m_Y.end() );
+   universe.m_VX.assign( m_Universe.m_VX.begin(), m_Universe.m_VX.end() );
+   universe.m_VY.assign( m_Universe.m_VY.begin(), m_Universe.m_VY.end() );
+   universe.m_AX.assign( m_Universe.m_AX.begin(), m_Universe.m_AX.end() );
+   universe.m_AY.assign( m_Universe.m_AY.begin(), m_Universe.m_AY.end() );
+   universe.m_Mass.assign( m_Universe.m_Mass.begin(), m_Universe.m_Mass.end() );
+   universe.m_Color.assign( m_Universe.m_Color.begin(), m_Universe.m_Color.end() );
+   snapshot.m_Rungs.assign( m_Integrator.getRungs().begin(), m_Integrator.getRungs().end() );
+   m_Tree.getLayout( snapshot.m_Tree );
+
+   snapshot.m_NumParticles = m_NumParticles;
+   snapshot.m_Seed = m_Seed;
+   snapshot.m_Steps = m_Steps;
+   snapshot.m_ForceEvaluations = m_Integrator.getForceEvaluations();
+   snapshot.m_Frame = m_Tree.getFrame();
+   snapshot.m_Solver = static_cast<uint32_t>( m_Solver );
+   snapshot.m_Theta = m_Tree.getTheta();
+   snapshot.m_Timestep = m_Integrator.getTimestep();
+   snapshot.m_Adaptive = m_Integrator.isAdaptive();
+}
+
+void Simulation::Step()
+{
+   m_Profiler.beginStep();
+   const size_t evaluations = m_Integrator.getForceEvaluations();
+
+   m_Integrator.step( m_Universe, m_NumParticles, [ this ]( const std::vector<uint8_t>& active ) { calcAccelerations( active ); } );
+   m_Steps++;
+
+   // The walks always count their interactions, take them even if they are not recorded
+   const size_t interactions = m_Tree.takeInteractions() + m_Multipole.takeInteractions();
+   if( m_Profiler.isEnabled() )
+   {
+      Profiler::Counters counters;
+      counters.m_Nodes = m_Tree.getNodeCount();
+      counters.m_Depth = m_Tree.getDepth();
+      counters.m_ForceEvaluations = m_Integrator.getForceEvaluations() - evaluations;
+      counters.m_Interactions = interactions;
+      m_Profiler.endStep( counters );
+   }
+}
+
+void Simulation::CalcAccelerations()
+{
+   calcAccelerations( std::vector<uint8_t>( m_NumParticles, 1 ) );
+
+   // Not part of any step
+   m_Tree.takeInteractions();
+   m_Multipole.takeInteractions();
+}
+
+void Simulation::Capture( Frame& frame ) const
+{
+   // assign keeps the capacity so a recycled frame does not allocate
+   frame.m_X.assign( m_Universe.m_X.begin(), m_Universe.m_X.end() );
+   frame.m_Y.assign( m_Universe.m_Y.begin(), m_Universe.m_Y.end() );
+   frame.m_Color.assign( m_Universe.m_Color.begin(), m_Universe.m_Color.end() );
+   frame.m_Step = m_Steps;
+   CollectOverlay( frame.m_Overlay );
+}
+
+void Simulation::CollectOverlay( QuadTree::Overlay& overlay ) const
+{
+   if( m_OverlayDepth == 0 )
+   {
+      overlay.m_X.clear();
+      overlay.m_Y.clear();
+      overlay.m_Heat.clear();
+      return;
+   }
+
+   m_Tree.collectOverlay( overlay, m_OverlayDepth, m_OverlayHeatmap );
+}
+
+void Simulation::calcAccelerations( const std::vector<uint8_t>& active )
+{
+   {
+      Profiler::Scope scope( m_Profiler, Profiler::TREE );
+      m_Tree.update( m_Universe, m_NumParticles );
+   }
+   {
+      Profiler::Scope scope( m_Profiler, Profiler::MOMENTS );
+      m_Tree.calcMassDistribution();
+   }
+
+   Profiler::Scope scope( m_Profiler, Profiler::FORCE );
+
+   switch( m_Solver )
+   {
+   case Solver::BARNES_HUT:
+      applyFilterOnUniverse( [ this, &active ]( size_t rank )
+      {
+         const size_t particle = m_Tree.getParticleInTreeOrder( rank );
+         if( !active[ particle ] ) return;
+
+         const glm::vec2 acc = m_Tree.calcForce( particle );
+         m_Universe.m_AX[ particle ] = acc.x;
+         m_Universe.m_AY[ particle ] = acc.y;
+      } );
+      break;
+   case Solver::BARNES_HUT_GROUPS:
+      m_Tree.calcGroupForces( active, m_Universe.m_AX.data(), m_Universe.m_AY.data() );
+      break;
+   case Solver::FAST_MULTIPOLE:
+      m_Multipole.calcForces( m_Tree, active, m_Universe.m_AX.data(), m_Universe.m_AY.data() );
+      break;
+   }
+}
+
+void Simulation::Print() const
+{
+   m_Tree.print();
+}
@@ -0,0 +1,124 @@
+/*
+MIT License
+
+Copyright (c) 2018 Chris McArthur, prince.chrismc(at)gmail(dot)com
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+#pragma once
+
+#include "Galaxy.h"
+#include "QuadTree.h"
+#include "FastMultipole.h"
+#include "Integrator.h"
+#include "Profiler.h"
+#include "Random.h"
+#include "Snapshot.h"
+#include "tbb/parallel_for.h"
+
+class Simulation
+{
+public:
+   enum class Solver { BARNES_HUT, BARNES_HUT_GROUPS, FAST_MULTIPOLE };
+
+   // The same seed reproduces the same run bit for bit, whatever the number of threads
+   explicit Simulation( size_t particles = DEFAULT_PARTICLES, uint64_t seed = Random::makeSeed() );
+
+   // Resumes from a snapshot with its solver, angle and timestep, the universe is moved out of it
+   explicit Simulation( Snapshot&& snapshot );
+
+   // Along with the quad tree's layout so a run resumed from the snapshot refits and rebuilds the tree on the same steps,
+   // it continues bit for bit. Saving leaves the simulation untouched
+   void Save( Snapshot& snapshot ) const;
+
+   void SetSolver( Solver solver ) { m_Solver = solver; }
+   void SetTheta( float theta ) { m_Tree.setTheta( theta ); }
+   void SetTimestep( float dt ) { m_Integrator.setTimestep( dt ); }
+   void SetAdaptive( bool adaptive ) { m_Integrator.setAdaptive( adaptive ); }
+
+   // Outlines the quad tree's cells down to `depth` levels in every captured frame, 0 turns the overlay off
+   void SetOverlay( unsigned depth, bool heatmap ) { m_OverlayDepth = depth; m_OverlayHeatmap = heatmap; }
+   void CollectOverlay( QuadTree::Overlay& overlay ) const;
+
+   void Step();
+
+   // Evaluates every particle with the current solver without advancing the universe, the accelerations are left in it
+   void CalcAccelerations();
+
+   // What the renderer needs of the universe, copied out so it can be drawn while the following steps run
+   struct Frame
+   {
+      Universe::Column<float> m_X;
+      Universe::Column<float> m_Y;
+      Universe::Column<ObjectColors> m_Color;
+      QuadTree::Overlay m_Overlay;
+      size_t m_Step{ 0 };
+   };
+   void Capture( Frame& frame ) const;
+
+   const Universe& GetUniverse() const { return m_Universe; }
+   size_t GetNumParticles() const { return m_NumParticles; }   // the whole universe, a snapshot may hold fewer
+   size_t GetSteps() const { return m_Steps; }
+   uint64_t GetSeed() const { return m_Seed; }
+   size_t GetForceEvaluations() const { return m_Integrator.getForceEvaluations(); }
+
+   // Records every step once enabled, the renderer may time its own phase with it
+   Profiler& GetProfiler() { return m_Profiler; }
+   void Print() const;
+
+   static constexpr const size_t DEFAULT_PARTICLES = 4300;
+   static constexpr const float BOUNDARY = 42.0f;   // the quad tree covers [ -BOUNDARY, BOUNDARY ]^2
+
+private:
+   Universe m_Universe;
+   uint64_t m_Seed;
+   size_t m_NumParticles;
+   size_t m_Steps{ 0 };
+
+   QuadTree m_Tree;
+   FastMultipole m_Multipole;
+   Solver m_Solver;
+
+   Integrator m_Integrator;
+   Profiler m_Profiler;
+
+   unsigned m_OverlayDepth{ 0 };
+   bool m_OverlayHeatmap{ false };
+
+   void calcAccelerations( const std::vector<uint8_t>& active );   // the tree always holds every particle
+
+   // The effect is inlined into the loop, it is called with every particle index
+   template<typename Effect>
+   void applyFilterOnUniverse( const Effect& effect );
+};
+
+template<typename Effect>
+void Simulation::applyFilterOnUniverse( const Effect& effect )
+{
+   tbb::parallel_for(
+      tbb::blocked_range<size_t>( 0, m_NumParticles ),
+      [ &effect ]( const tbb::blocked_range<size_t>& range )
+      {
+         for( size_t i = range.begin(); i < range.end(); i++ )
+            effect( i );
+      }
+   );
+}
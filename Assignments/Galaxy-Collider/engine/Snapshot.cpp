@@ -0,0 +1,345 @@
+/*
+MIT License
+
+Copyright (c) 2018 Chris McArthur, prince.chrismc(at)gmail(dot)com
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+
+#include "Snapshot.h"
+#include "tbb/blocked_range.h"
+#include "tbb/parallel_for.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+#if defined( _WIN32 )
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+constexpr const char Snapshot::MAGIC[ 8 ];
+
+namespace
+{
+   static_assert( sizeof( Snapshot::Header ) <= Snapshot::PAGE_BYTES, "The header must fit in the first page" );
+
+   bool isLittleEndian()
+   {
+      const uint32_t one = 1;
+      unsigned char first;
+      std::memcpy( &first, &one, 1 );
+      return first == 1;
+   }
+
+   uint64_t alignToPage( uint64_t offset ) { return ( offset + Snapshot::PAGE_BYTES - 1 ) / Snapshot::PAGE_BYTES * Snapshot::PAGE_BYTES; }
+
+   // Read only view of a whole file
+   class MappedFile
+   {
+   public:
+      explicit MappedFile( const std::string& path )
+      {
+#if defined( _WIN32 )
+         m_File = CreateFileA( path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr );
+         if( m_File == INVALID_HANDLE_VALUE ) return;
+
+         LARGE_INTEGER size;
+         if( !GetFileSizeEx( m_File, &size ) || size.QuadPart == 0 ) return;
+         m_Mapping = CreateFileMappingA( m_File, nullptr, PAGE_READONLY, 0, 0, nullptr );
+         if( m_Mapping == nullptr ) return;
+
+         m_Data = static_cast<const unsigned char*>( MapViewOfFile( m_Mapping, FILE_MAP_READ, 0, 0, 0 ) );
+         if( m_Data != nullptr ) m_Size = static_cast<size_t>( size.QuadPart );
+#else
+         const int file = open( path.c_str(), O_RDONLY );
+         if( file < 0 ) return;
+
+         struct stat info;
+         if( fstat( file, &info ) == 0 && info.st_size > 0 )
+         {
+            void* data = mmap( nullptr, static_cast<size_t>( info.st_size ), PROT_READ, MAP_PRIVATE, file, 0 );
+            if( data != MAP_FAILED )
+            {
+               m_Data = static_cast<const unsigned char*>( data );
+               m_Size = static_cast<size_t>( info.st_size );
+            }
+         }
+         close( file );    // the mapping keeps the file alive
+#endif
+      }
+
+      MappedFile( const MappedFile& ) = delete;
+      MappedFile& operator=( const MappedFile& ) = delete;
+
+      ~MappedFile()
+      {
+#if defined( _WIN32 )
+         if( m_Data != nullptr ) UnmapViewOfFile( m_Data );
+         if( m_Mapping != nullptr ) CloseHandle( m_Mapping );
+         if( m_File != INVALID_HANDLE_VALUE ) CloseHandle( m_File );
+#else
+         if( m_Data != nullptr ) munmap( const_cast<unsigned char*>( m_Data ), m_Size );
+#endif
+      }
+
+      const unsigned char* data() const { return m_Data; }
+      size_t size() const { return m_Size; }
+
+   private:
+      const unsigned char* m_Data{ nullptr };
+      size_t m_Size{ 0 };
+#if defined( _WIN32 )
+      HANDLE m_File{ INVALID_HANDLE_VALUE };
+      HANDLE m_Mapping{ nullptr };
+#endif
+   };
+
+   // Source of every column, colors are widened back to the enum on load
+   struct ColumnView
+   {
+      const void* m_Data;
+      uint32_t m_ElementSize;
+      uint64_t m_Count;
+   };
+}
+
+bool Snapshot::write( const std::string& path ) const
+{
+   if( !isLittleEndian() ) return false;
+
+   const uint64_t size = m_Universe.size();
+   std::vector<uint8_t> colors( size );
+   for( size_t i = 0; i < size; i++ )
+      colors[ i ] = static_cast<uint8_t>( m_Universe.m_Color[ i ] );
+   const uint32_t treeState[ 2 ] = { m_Tree.m_Bodies, m_Tree.m_FramesSinceRebuild };
+
+   const ColumnView views[ COLUMNS ] = {
+      { m_Universe.m_X.data(), sizeof( float ), size },
+      { m_Universe.m_Y.data(), sizeof( float ), size },
+      { m_Universe.m_VX.data(), sizeof( float ), size },
+      { m_Universe.m_VY.data(), sizeof( float ), size },
+      { m_Universe.m_AX.data(), sizeof( float ), size },
+      { m_Universe.m_AY.data(), sizeof( float ), size },
+      { m_Universe.m_Mass.data(), sizeof( float ), size },
+      { colors.data(), sizeof( uint8_t ), size },
+      { m_Rungs.data(), sizeof( uint8_t ), m_Rungs.size() },
+      { m_Tree.m_Keys.data(), sizeof( uint64_t ), m_Tree.m_Keys.size() },
+      { m_Tree.m_Particles.data(), sizeof( int32_t ), m_Tree.m_Particles.size() },
+      { m_Tree.m_Nodes.data(), sizeof( int32_t ), m_Tree.m_Nodes.size() },
+      { m_Tree.m_Bounds.data(), sizeof( float ), m_Tree.m_Bounds.size() },
+      { m_Tree.m_Dropped.data(), sizeof( int32_t ), m_Tree.m_Dropped.size() },
+      { treeState, sizeof( uint32_t ), m_Tree.m_Nodes.empty() ? 0u : 2u },
+   };
+
+   Header header;
+   std::memset( &header, 0, sizeof( header ) );
+   std::memcpy( header.m_Magic, MAGIC, sizeof( MAGIC ) );
+   header.m_Version = VERSION;
+   header.m_EndianMark = ENDIAN_MARK;
+   header.m_Size = size;
+   header.m_NumParticles = m_NumParticles;
+   header.m_Seed = m_Seed;
+   header.m_Steps = m_Steps;
+   header.m_ForceEvaluations = m_ForceEvaluations;
+   header.m_Frame = m_Frame;
+   header.m_Solver = m_Solver;
+   header.m_Theta = m_Theta;
+   header.m_Timestep = m_Timestep;
+   header.m_Adaptive = m_Adaptive ? 1 : 0;
+   header.m_ColumnCount = COLUMNS;
+
+   uint64_t offset = PAGE_BYTES;
+   for( uint32_t column = 0; column < COLUMNS; column++ )
+   {
+      header.m_Columns[ column ] = { column, views[ column ].m_ElementSize, offset, views[ column ].m_Count };
+      offset = alignToPage( offset + views[ column ].m_Count * views[ column ].m_ElementSize );
+   }
+
+   const std::string temporary = path + ".tmp";
+   std::FILE* file = std::fopen( temporary.c_str(), "wb" );
+   if( file == nullptr ) return false;
+
+   static const unsigned char PADDING[ PAGE_BYTES ] = {};
+   bool written = std::fwrite( &header, sizeof( header ), 1, file ) == 1;
+   uint64_t position = sizeof( header );
+   for( uint32_t column = 0; column < COLUMNS && written; column++ )
+   {
+      const ColumnEntry& entry = header.m_Columns[ column ];
+      const size_t bytes = static_cast<size_t>( entry.m_Count * entry.m_ElementSize );
+
+      written = std::fwrite( PADDING, 1, static_cast<size_t>( entry.m_Offset - position ), file ) == entry.m_Offset - position &&
+                ( bytes == 0 || std::fwrite( views[ column ].m_Data, 1, bytes, file ) == bytes );
+      position = entry.m_Offset + bytes;
+   }
+
+   // The snapshot has to be on disk before it replaces the previous one
+   written = std::fflush( file ) == 0 && written;
+#if !defined( _WIN32 )
+   written = written && fsync( fileno( file ) ) == 0;
+#endif
+   written = std::fclose( file ) == 0 && written;
+
+#if defined( _WIN32 )
+   written = written && MoveFileExA( temporary.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH );
+#else
+   written = written && std::rename( temporary.c_str(), path.c_str() ) == 0;
+#endif
+
+   if( !written ) std::remove( temporary.c_str() );
+   return written;
+}
+
+bool Snapshot::load( const std::string& path )
+{
+   if( !isLittleEndian() ) return false;
+
+   const MappedFile file( path );
+   if( file.data() == nullptr || file.size() < PAGE_BYTES ) return false;
+
+   Header header;
+   std::memcpy( &header, file.data(), sizeof( header ) );
+   if( std::memcmp( header.m_Magic, MAGIC, sizeof( MAGIC ) ) != 0 || header.m_Version > VERSION || header.m_EndianMark != ENDIAN_MARK ||
+       header.m_NumParticles > header.m_Size || header.m_ColumnCount > COLUMNS )
+      return false;
+
+   // Settings the simulation would run with unchecked
+   if( header.m_Solver >= SOLVERS || !std::isfinite( header.m_Theta ) || header.m_Theta <= 0.0f || !std::isfinite( header.m_Timestep ) ||
+       header.m_Timestep <= 0.0f || header.m_Adaptive > 1 )
+      return false;
+
+   // Every column is required except the rungs and the tree, which are only there after the first step. The tree's
+   // columns are checked as a whole once they are read
+   static const uint32_t ELEMENT_SIZES[ COLUMNS ] = { sizeof( float ), sizeof( float ), sizeof( float ), sizeof( float ), sizeof( float ),
+                                                      sizeof( float ), sizeof( float ), sizeof( uint8_t ), sizeof( uint8_t ), sizeof( uint64_t ),
+                                                      sizeof( int32_t ), sizeof( int32_t ), sizeof( float ), sizeof( int32_t ), sizeof( uint32_t ) };
+   const ColumnEntry* entries[ COLUMNS ] = {};
+   for( uint32_t i = 0; i < header.m_ColumnCount; i++ )
+   {
+      const ColumnEntry& entry = header.m_Columns[ i ];
+      if( entry.m_Id >= COLUMNS ) continue;
+
+      bool expected = true;
+      switch( entry.m_Id )
+      {
+      case RUNG:
+      case TREE_KEYS:
+      case TREE_PARTICLES: expected = entry.m_Count == 0 || entry.m_Count == header.m_NumParticles; break;
+      case TREE_NODES:
+      case TREE_BOUNDS:
+      case TREE_DROPPED: break;
+      case TREE_STATE: expected = entry.m_Count == 0 || entry.m_Count == 2; break;
+      default: expected = entry.m_Count == header.m_Size; break;
+      }
+      if( !expected || entry.m_ElementSize != ELEMENT_SIZES[ entry.m_Id ] || entry.m_Offset % PAGE_BYTES != 0 || entry.m_Offset > file.size() ||
+          entry.m_Count > file.size() || entry.m_Count * entry.m_ElementSize > file.size() - entry.m_Offset )
+         return false;
+
+      entries[ entry.m_Id ] = &entry;
+   }
+   for( uint32_t column = 0; column < RUNG; column++ )
+      if( entries[ column ] == nullptr ) return false;
+
+   const size_t size = static_cast<size_t>( header.m_Size );
+   m_Universe.m_X.resize( size );
+   m_Universe.m_Y.resize( size );
+   m_Universe.m_VX.resize( size );
+   m_Universe.m_VY.resize( size );
+   m_Universe.m_AX.resize( size );
+   m_Universe.m_AY.resize( size );
+   m_Universe.m_Mass.resize( size );
+   m_Universe.m_Color.resize( size );
+
+   float* const floats[ COLOR ] = { m_Universe.m_X.data(), m_Universe.m_Y.data(), m_Universe.m_VX.data(), m_Universe.m_VY.data(),
+                                    m_Universe.m_AX.data(), m_Universe.m_AY.data(), m_Universe.m_Mass.data() };
+   const unsigned char* colors = file.data() + entries[ COLOR ]->m_Offset;
+
+   // Touching the pages from every thread faults them in concurrently
+   tbb::parallel_for(
+      tbb::blocked_range<size_t>( 0, size, PAGE_BYTES ),
+      [ & ]( const tbb::blocked_range<size_t>& range )
+      {
+         for( uint32_t column = 0; column < COLOR; column++ )
+            std::memcpy( floats[ column ] + range.begin(), file.data() + entries[ column ]->m_Offset + range.begin() * sizeof( float ),
+                         range.size() * sizeof( float ) );
+
+         for( size_t i = range.begin(); i < range.end(); i++ )
+            m_Universe.m_Color[ i ] = static_cast<ObjectColors>( colors[ i ] );
+      }
+   );
+
+   // The optional columns are small next to the universe
+   const auto copyColumn = [ &file, &entries ]( Column column, auto& out )
+   {
+      out.resize( entries[ column ] != nullptr ? static_cast<size_t>( entries[ column ]->m_Count ) : 0 );
+      if( !out.empty() ) std::memcpy( out.data(), file.data() + entries[ column ]->m_Offset, out.size() * sizeof( out[ 0 ] ) );
+   };
+   copyColumn( RUNG, m_Rungs );
+   if( std::any_of( m_Rungs.begin(), m_Rungs.end(), []( uint8_t rung ) { return rung > Integrator::MAX_RUNG; } ) ) return false;
+   if( std::any_of( colors, colors + size, []( unsigned char color ) { return color >= PALETTE_SIZE; } ) ) return false;
+   copyColumn( TREE_KEYS, m_Tree.m_Keys );
+   copyColumn( TREE_PARTICLES, m_Tree.m_Particles );
+   copyColumn( TREE_NODES, m_Tree.m_Nodes );
+   copyColumn( TREE_BOUNDS, m_Tree.m_Bounds );
+   copyColumn( TREE_DROPPED, m_Tree.m_Dropped );
+   std::vector<uint32_t> treeState;
+   copyColumn( TREE_STATE, treeState );
+   m_Tree.m_Bodies = treeState.empty() ? 0 : treeState[ 0 ];
+   m_Tree.m_FramesSinceRebuild = treeState.empty() ? 0 : treeState[ 1 ];
+   if( !QuadTree::isValid( m_Tree, static_cast<size_t>( header.m_NumParticles ) ) ) return false;
+
+   m_NumParticles = static_cast<size_t>( header.m_NumParticles );
+   m_Seed = header.m_Seed;
+   m_Steps = header.m_Steps;
+   m_ForceEvaluations = header.m_ForceEvaluations;
+   m_Frame = header.m_Frame;
+   m_Solver = header.m_Solver;
+   m_Theta = header.m_Theta;
+   m_Timestep = header.m_Timestep;
+   m_Adaptive = header.m_Adaptive != 0;
+   return true;
+}
+
+Snapshot& SnapshotWriter::acquire()
+{
+   wait();
+   return m_Snapshot;
+}
+
+void SnapshotWriter::commit( const std::string& path )
+{
+   m_Thread = std::thread( [ this, path ]()
+   {
+      if( !m_Snapshot.write( path ) ) m_Succeeded = false;
+   } );
+}
+
+bool SnapshotWriter::wait()
+{
+   if( m_Thread.joinable() ) m_Thread.join();
+   return m_Succeeded;
+}
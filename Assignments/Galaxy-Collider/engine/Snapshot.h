@@ -0,0 +1,122 @@
+/*
+MIT License
+
+Copyright (c) 2018 Chris McArthur, prince.chrismc(at)gmail(dot)com
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+
+#pragma once
+
+#include "Integrator.h"
+#include "QuadTree.h"
+#include "Universe.h"
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Everything needed to resume a simulation between two steps. On disk it is a page holding the header followed by one
+// page aligned block per column, all little-endian, so a loader can map the file and copy the columns straight out of it
+class Snapshot
+{
+public:
+   Universe m_Universe;
+   std::vector<uint8_t> m_Rungs;     // empty before the first step
+   QuadTree::Layout m_Tree;          // empty before the first step and in version 1 snapshots, the tree is then rebuilt
+   size_t m_NumParticles{ 0 };
+   uint64_t m_Seed{ 0 };
+   uint64_t m_Steps{ 0 };
+   uint64_t m_ForceEvaluations{ 0 };
+   uint32_t m_Frame{ 0 };            // of the quad tree, collisions draw their random numbers from it
+   uint32_t m_Solver{ 0 };           // a Simulation::Solver, below SOLVERS
+   float m_Theta{ 0.0f };
+   float m_Timestep{ 0.0f };
+   bool m_Adaptive{ false };
+
+   // Writes to a temporary file next to `path` and renames it over `path` once it is complete, a crash while writing
+   // leaves the previous snapshot intact
+   bool write( const std::string& path ) const;
+
+   // Maps the file and copies the columns out in parallel, fails on a snapshot of a newer version, a damaged one or one
+   // with settings the simulation can not run with
+   bool load( const std::string& path );
+
+   enum Column : uint32_t { X, Y, VX, VY, AX, AY, MASS, COLOR, RUNG, TREE_KEYS, TREE_PARTICLES, TREE_NODES, TREE_BOUNDS, TREE_DROPPED,
+                            TREE_STATE, COLUMNS };
+
+   struct ColumnEntry
+   {
+      uint32_t m_Id;
+      uint32_t m_ElementSize;
+      uint64_t m_Offset;           // from the start of the file, a multiple of PAGE_BYTES
+      uint64_t m_Count;
+   };
+
+   struct Header
+   {
+      char m_Magic[ 8 ];
+      uint32_t m_Version;
+      uint32_t m_EndianMark;       // ENDIAN_MARK as written
+      uint64_t m_Size;
+      uint64_t m_NumParticles;
+      uint64_t m_Seed;
+      uint64_t m_Steps;
+      uint64_t m_ForceEvaluations;
+      uint32_t m_Frame;
+      uint32_t m_Solver;
+      float m_Theta;
+      float m_Timestep;
+      uint32_t m_Adaptive;
+      uint32_t m_ColumnCount;
+      ColumnEntry m_Columns[ COLUMNS ];   // readers skip the ids they do not know
+   };
+
+   static constexpr const char MAGIC[ 8 ] = { 'G', 'A', 'L', 'A', 'X', 'Y', 'S', 'N' };
+   static constexpr const uint32_t VERSION = 2;    // 2 added the TREE_ columns
+   static constexpr const uint32_t ENDIAN_MARK = 0x01020304;
+   static constexpr const uint32_t SOLVERS = 3;
+   static constexpr const size_t PAGE_BYTES = 4096;
+};
+
+// Writes snapshots on a background thread so the simulation only pays for copying its state, one write at a time
+class SnapshotWriter
+{
+public:
+   SnapshotWriter() = default;
+   SnapshotWriter( const SnapshotWriter& ) = delete;
+   SnapshotWriter& operator=( const SnapshotWriter& ) = delete;
+   ~SnapshotWriter() { wait(); }
+
+   // Waits for the previous write, the snapshot can then be filled in until commit. Its columns keep their capacity
+   // so checkpoints stop allocating after the first one
+   Snapshot& acquire();
+   void commit( const std::string& path );
+
+   // Returns whether every write so far succeeded
+   bool wait();
+
+private:
+   Snapshot m_Snapshot;
+   std::thread m_Thread;
+   std::atomic<bool> m_Succeeded{ true };
+};
@@ -0,0 +1,63 @@
+/*
+MIT License
+
+Copyright (c) 2018 Chris McArthur, prince.chrismc(at)gmail(dot)com
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+// Lock free hand off between one producer and one consumer, the producer always has a buffer to write into and the
+// consumer always reads the latest complete one, neither of them ever waits on the other. Buffers which are not picked up
+// in time are simply overwritten.
+template<typename T>
+class TripleBuffer
+{
+public:
+   // Producer
+   T& getBack() { return m_Buffers[ m_Back ]; }
+   void publish() { m_Back = m_Middle.exchange( m_Back | FRESH, std::memory_order_acq_rel ) & INDEX; }
+
+   // Consumer, returns false and keeps the current front if nothing was published since the last call
+   bool acquire()
+   {
+      if( ( m_Middle.load( std::memory_order_relaxed ) & FRESH ) == 0 ) return false;
+
+      m_Front = m_Middle.exchange( m_Front, std::memory_order_acq_rel ) & INDEX;
+      return true;
+   }
+   const T& getFront() const { return m_Buffers[ m_Front ]; }
+
+private:
+   static constexpr const uint8_t INDEX = 0x3;
+   static constexpr const uint8_t FRESH = 0x4;
+
+   std::array<T, 3> m_Buffers;
+
+   // Each side only touches its own index and the shared middle, they are kept on separate cache lines
+   alignas( 64 ) uint8_t m_Back{ 0 };
+   alignas( 64 ) std::atomic<uint8_t> m_Middle{ 1 };
+   alignas( 64 ) uint8_t m_Front{ 2 };
+};
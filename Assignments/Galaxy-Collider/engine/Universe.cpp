@@ -0,0 +1,50 @@
+/*
+MIT License
+
+Copyright (c) 2018 Chris McArthur, prince.chrismc(at)gmail(dot)com
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+#include "Universe.h"
+
+size_t Universe::add( ObjectColors col, float x, float y, float m )
+{
+   const size_t index = grow( 1 );
+   m_X[ index ] = x;
+   m_Y[ index ] = y;
+   m_Mass[ index ] = m;
+   m_Color[ index ] = col;
+   return index;
+}
+
+size_t Universe::grow( size_t count )
+{
+   const size_t first = size();
+   m_X.resize( first + count );
+   m_Y.resize( first + count );
+   m_VX.resize( first + count );
+   m_VY.resize( first + count );
+   m_AX.resize( first + count );
+   m_AY.resize( first + count );
+   m_Mass.resize( first + count );
+   m_Color.resize( first + count );
+   return first;
+}
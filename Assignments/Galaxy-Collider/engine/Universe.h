@@ -0,0 +1,59 @@
+/*
+MIT License
+
+Copyright (c) 2018 Chris McArthur, prince.chrismc(at)gmail(dot)com
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+#pragma once
+
+#include "glm/vec2.hpp"
+#include "ObjectColors.h"
+#include "CountedAllocator.h"
+#include <vector>
+
+// Structure of arrays, each column is cache line aligned so the force kernels can stream them
+class Universe
+{
+public:
+   template<typename T>
+   using Column = std::vector<T, CountedAllocator<T>>;
+
+   size_t size() const { return m_X.size(); }
+
+   size_t add( ObjectColors col, float x, float y, float m );
+   size_t grow( size_t count );
+
+   glm::vec2 getPos( size_t i ) const { return { m_X[ i ], m_Y[ i ] }; }
+   void setPos( size_t i, const glm::vec2& pos ) { m_X[ i ] = pos.x; m_Y[ i ] = pos.y; }
+
+   glm::vec2 getVel( size_t i ) const { return { m_VX[ i ], m_VY[ i ] }; }
+   void setVel( size_t i, const glm::vec2& vel ) { m_VX[ i ] = vel.x; m_VY[ i ] = vel.y; }
+
+   Column<float> m_X;
+   Column<float> m_Y;
+   Column<float> m_VX;
+   Column<float> m_VY;
+   Column<float> m_AX;     // acceleration at the current position, filled in by the force solvers
+   Column<float> m_AY;
+   Column<float> m_Mass;
+   Column<ObjectColors> m_Color;
+};
@@ -0,0 +1,139 @@
+/*
+MIT License
+
+Copyright (c) 2018 Chris McArthur, prince.chrismc(at)gmail(dot)com
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+
+#include "Validation.h"
+#include "Gravity.h"
+#include "tbb/blocked_range.h"
+#include "tbb/parallel_for.h"
+#include "tbb/parallel_reduce.h"
+#include "tbb/parallel_sort.h"
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <vector>
+
+void Validation::calcDirectAccelerations( const Universe& universe, size_t particles, float* acc_x, float* acc_y )
+{
+   tbb::parallel_for(
+      tbb::blocked_range<size_t>( 0, particles ),
+      [ &universe, particles, acc_x, acc_y ]( const tbb::blocked_range<size_t>& range )
+      {
+         for( size_t i = range.begin(); i < range.end(); i++ )
+         {
+            double ax = 0.0;
+            double ay = 0.0;
+            for( size_t first = 0; first < particles; first += SOURCE_BLOCK )
+            {
+               float block_x = 0.0f;
+               float block_y = 0.0f;
+               Gravity::accumulate( universe.m_X[ i ], universe.m_Y[ i ], universe.m_X.data() + first, universe.m_Y.data() + first,
+                                    universe.m_Mass.data() + first, std::min( SOURCE_BLOCK, particles - first ), block_x, block_y );
+               ax += block_x;
+               ay += block_y;
+            }
+
+            acc_x[ i ] = static_cast<float>( ax );
+            acc_y[ i ] = static_cast<float>( ay );
+         }
+      }
+   );
+}
+
+Validation::ForceError Validation::calcForceError( const float* acc_x, const float* acc_y, const float* exact_x, const float* exact_y, size_t particles )
+{
+   ForceError error;
+   if( particles == 0 ) return error;
+
+   std::vector<double> relative( particles );
+   tbb::parallel_for(
+      tbb::blocked_range<size_t>( 0, particles ),
+      [ & ]( const tbb::blocked_range<size_t>& range )
+      {
+         for( size_t i = range.begin(); i < range.end(); i++ )
+         {
+            const double dx = static_cast<double>( acc_x[ i ] ) - exact_x[ i ];
+            const double dy = static_cast<double>( acc_y[ i ] ) - exact_y[ i ];
+            const double exact = std::hypot( static_cast<double>( exact_x[ i ] ), static_cast<double>( exact_y[ i ] ) );
+            relative[ i ] = exact > 0.0 ? std::hypot( dx, dy ) / exact : 0.0;
+         }
+      }
+   );
+   tbb::parallel_sort( relative.begin(), relative.end() );
+
+   double sum = 0.0;
+   for( double e : relative )
+      sum += e * e;
+
+   error.m_RMS = std::sqrt( sum / particles );
+   error.m_Median = relative[ particles / 2 ];
+   error.m_P99 = relative[ std::min( particles - 1, particles * 99 / 100 ) ];
+   error.m_Max = relative.back();
+   return error;
+}
+
+Validation::Invariants Validation::calcInvariants( const Universe& universe, size_t particles )
+{
+   Invariants invariants;
+   for( size_t i = 0; i < particles; i++ )
+   {
+      const double m = universe.m_Mass[ i ];
+      const double vx = universe.m_VX[ i ];
+      const double vy = universe.m_VY[ i ];
+
+      invariants.m_Mass += m;
+      invariants.m_Kinetic += 0.5 * m * ( vx * vx + vy * vy );
+      invariants.m_Momentum += glm::dvec2{ m * vx, m * vy };
+      invariants.m_AbsMomentum += m * std::sqrt( vx * vx + vy * vy );
+      invariants.m_AngularMomentum += m * ( universe.m_X[ i ] * vy - universe.m_Y[ i ] * vx );
+   }
+
+   // Every pair once, the deterministic reduction splits the same way on any number of threads
+   const double potential = tbb::parallel_deterministic_reduce(
+      tbb::blocked_range<size_t>( 0, particles, 64 ), 0.0,
+      [ &universe, particles ]( const tbb::blocked_range<size_t>& range, double sum )
+      {
+         for( size_t i = range.begin(); i < range.end(); i++ )
+         {
+            const double x = universe.m_X[ i ];
+            const double y = universe.m_Y[ i ];
+
+            double pair = 0.0;
+            for( size_t j = i + 1; j < particles; j++ )
+            {
+               const double dx = universe.m_X[ j ] - x;
+               const double dy = universe.m_Y[ j ] - y;
+               pair += universe.m_Mass[ j ] / std::sqrt( dx * dx + dy * dy + Gravity::SOFTENING2 );
+            }
+            sum -= universe.m_Mass[ i ] * pair;
+         }
+         return sum;
+      },
+      std::plus<double>()
+   );
+
+   invariants.m_Potential = Gravity::GAMMA * potential;
+   return invariants;
+}
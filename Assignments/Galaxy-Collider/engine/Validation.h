@@ -0,0 +1,64 @@
+/*
+MIT License
+
+Copyright (c) 2018 Chris McArthur, prince.chrismc(at)gmail(dot)com
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+
+#pragma once
+
+#include "Universe.h"
+#include "glm/vec2.hpp"
+
+// Reference values to measure the solvers and the integrator against, everything here is O( N^2 )
+namespace Validation
+{
+   // Exact accelerations from summing every pair with the solvers' softened kernel, in parallel over the targets with the
+   // vectorized kernel over the sources. Each block of sources is summed in float and the blocks in double
+   void calcDirectAccelerations( const Universe& universe, size_t particles, float* acc_x, float* acc_y );
+
+   // Relative error | a - a_exact | / | a_exact | of every particle
+   struct ForceError
+   {
+      double m_RMS{ 0.0 };
+      double m_Median{ 0.0 };
+      double m_P99{ 0.0 };
+      double m_Max{ 0.0 };
+   };
+   ForceError calcForceError( const float* acc_x, const float* acc_y, const float* exact_x, const float* exact_y, size_t particles );
+
+   // Conserved quantities of the first `particles` bodies, summed in double in a fixed order so they are reproducible
+   struct Invariants
+   {
+      double m_Mass{ 0.0 };
+      double m_Kinetic{ 0.0 };
+      double m_Potential{ 0.0 };          // softened, - G m_i m_j / sqrt( r^2 + e^2 ) over every pair
+      glm::dvec2 m_Momentum{ 0.0, 0.0 };
+      double m_AbsMomentum{ 0.0 };        // sum of m | v |, the scale of the momentum since it is close to zero
+      double m_AngularMomentum{ 0.0 };
+
+      double getEnergy() const { return m_Kinetic + m_Potential; }
+   };
+   Invariants calcInvariants( const Universe& universe, size_t particles );
+
+   static constexpr const size_t SOURCE_BLOCK = 4096;
+};
@@ -1,12 +1,31 @@
 #version 330 core
 
-layout (location = 0) in vec3 position;
+// Positions are streamed straight from the universe's columns
+layout (location = 0) in float position_x;
+layout (location = 1) in float position_y;
+layout (location = 2) in int object_color;
+layout (location = 3) in float heat;       // [ 0, 1 ] for the heatmap, negative to use the object color
 
-uniform mat4 model_matrix;
 uniform mat4 view_matrix;
 uniform mat4 projection_matrix;
 
+flat out vec4 vertex_color;
+
+const vec4 PALETTE[6] = vec4[6](
+   vec4(1.0f, 0.0f, 0.0f, 1.0f),    // red
+   vec4(0.0f, 1.0f, 0.0f, 1.0f),    // green
+   vec4(0.0f, 0.0f, 1.0f, 1.0f),    // blue
+   vec4(0.5f, 0.5f, 0.5f, 1.0f),    // grey
+   vec4(1.0f, 0.9333f, 0.0f, 1.0f), // pacman yellow
+   vec4(0.0f, 0.5f, 0.5f, 1.0f)     // teal
+);
+
 void main()
 {
-   gl_Position = projection_matrix * view_matrix * model_matrix * vec4(position, 1.0);
+   gl_Position = projection_matrix * view_matrix * vec4(position_x, position_y, 0.0, 1.0);
+   if (heat >= 0.0)
+      vertex_color = heat < 0.5 ? mix(vec4(0.0f, 0.0f, 1.0f, 1.0f), vec4(0.0f, 1.0f, 0.0f, 1.0f), heat * 2.0) : // cold blue to green
+                                  mix(vec4(0.0f, 1.0f, 0.0f, 1.0f), vec4(1.0f, 0.0f, 0.0f, 1.0f), heat * 2.0 - 1.0); // to hot red
+   else
+      vertex_color = (object_color >= 0 && object_color < 6) ? PALETTE[object_color] : vec4(1.0f, 1.0f, 1.0f, 1.0f);
 }
@@ -0,0 +1,106 @@
+/*
+MIT License
+
+Copyright (c) 2018 Chris McArthur, prince.chrismc(at)gmail(dot)com
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+#include "OverlayModel.h"
+#include "Linked.h"
+#include <algorithm>
+
+std::once_flag OverlayModel::s_Flag;
+std::unique_ptr<OverlayModel> OverlayModel::s_Instance;
+
+OverlayModel::OverlayModel()
+{
+   const auto shaderProgram = Shader::Linked::GetInstance();
+   m_PositionXIndex = shaderProgram->GetAttributeLocation( "position_x" );
+   m_PositionYIndex = shaderProgram->GetAttributeLocation( "position_y" );
+   m_ColorIndex = shaderProgram->GetAttributeLocation( "object_color" );
+   m_HeatIndex = shaderProgram->GetAttributeLocation( "heat" );
+
+   glGenVertexArrays( 1, &m_VAO );
+   glGenBuffers( 1, &m_Vertices );
+
+   glBindVertexArray( m_VAO );
+   glEnableVertexAttribArray( m_PositionXIndex );
+   glEnableVertexAttribArray( m_PositionYIndex );
+   glBindVertexArray( 0 );
+}
+
+OverlayModel::~OverlayModel()
+{
+   glDeleteBuffers( 1, &m_Vertices );
+   glDeleteVertexArrays( 1, &m_VAO );
+}
+
+OverlayModel& OverlayModel::GetInstance()
+{
+   std::call_once( s_Flag, []() { s_Instance.reset( new OverlayModel() ); } );
+   return *s_Instance;
+}
+
+void OverlayModel::reserve( size_t count )
+{
+   if( count <= m_Capacity ) return;
+
+   m_Capacity = std::max( count, 2 * m_Capacity );
+   glBufferData( GL_ARRAY_BUFFER, m_Capacity * 3 * sizeof( GLfloat ), nullptr, GL_STREAM_DRAW );
+
+   glVertexAttribPointer( m_PositionXIndex, 1, GL_FLOAT, GL_FALSE, sizeof( GLfloat ), (GLvoid*)0 );
+   glVertexAttribPointer( m_PositionYIndex, 1, GL_FLOAT, GL_FALSE, sizeof( GLfloat ), (GLvoid*)( m_Capacity * sizeof( GLfloat ) ) );
+   glVertexAttribPointer( m_HeatIndex, 1, GL_FLOAT, GL_FALSE, sizeof( GLfloat ), (GLvoid*)( 2 * m_Capacity * sizeof( GLfloat ) ) );
+}
+
+void OverlayModel::Draw( const QuadTree::Overlay& overlay, ObjectColors color )
+{
+   const size_t count = overlay.m_X.size();
+   if( count == 0 ) return;
+
+   const bool heatmap = overlay.m_Heat.size() == count;
+
+   glBindVertexArray( m_VAO );
+   glBindBuffer( GL_ARRAY_BUFFER, m_Vertices );
+   reserve( count );
+
+   glBufferData( GL_ARRAY_BUFFER, m_Capacity * 3 * sizeof( GLfloat ), nullptr, GL_STREAM_DRAW );
+   glBufferSubData( GL_ARRAY_BUFFER, 0, count * sizeof( GLfloat ), overlay.m_X.data() );
+   glBufferSubData( GL_ARRAY_BUFFER, m_Capacity * sizeof( GLfloat ), count * sizeof( GLfloat ), overlay.m_Y.data() );
+
+   // Without the heatmap every line has the same color, the disabled attributes use their current values
+   if( heatmap )
+   {
+      glBufferSubData( GL_ARRAY_BUFFER, 2 * m_Capacity * sizeof( GLfloat ), count * sizeof( GLfloat ), overlay.m_Heat.data() );
+      glEnableVertexAttribArray( m_HeatIndex );
+   }
+   else
+   {
+      glDisableVertexAttribArray( m_HeatIndex );
+      glVertexAttrib1f( m_HeatIndex, -1.0f );
+   }
+   glVertexAttribI1i( m_ColorIndex, static_cast<GLint>( color ) );
+
+   glDrawArrays( GL_LINES, 0, static_cast<GLsizei>( count ) );
+
+   glBindBuffer( GL_ARRAY_BUFFER, 0 );
+   glBindVertexArray( 0 );
+}
@@ -22,52 +22,47 @@ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
 SOFTWARE.
 */
 
+
 #pragma once
 
 #include <mutex>
 #include <memory>
 #include <GL/glew.h>
-#include "glm/vec2.hpp"
 #include "ObjectColors.h"
+#include "QuadTree.h"
 
-class Particle
+// Draws the quad tree overlay collected by the simulation as GL_LINES with a single call, colored by the heatmap if it
+// has one
+class OverlayModel final
 {
 public:
-   Particle( ObjectColors col, float x, float  y, long double m ) : m_Pos( x, y ), m_Mass( m ), m_Color(col) {}
-   virtual ~Particle() = default;
-
-   virtual void Draw() const;
+   OverlayModel( const OverlayModel& ) = delete;
+   OverlayModel( const OverlayModel&& ) = delete;
+   ~OverlayModel();
 
-   glm::vec2 m_Pos;
-   long double m_Mass;
-   ObjectColors m_Color;
+   void operator=( const OverlayModel& ) = delete;
+   void operator=( const OverlayModel&& ) = delete;
 
-private:
-   class Model;
-};
+   static OverlayModel& GetInstance();
 
-class Particle::Model final
-{
-public:
-   Model( const Model& ) = delete;
-   Model( const Model&& ) = delete;
-   ~Model();
-
-   void operator=( const Model& ) = delete;
-   void operator=( const Model&& ) = delete;
-
-   static const Model& GetInstance();
-
-   void Draw() const;
+   void Draw( const QuadTree::Overlay& overlay, ObjectColors color = ObjectColors::GREY );
 
 private:
-   Model();
+   OverlayModel();
 
    GLuint m_VAO{};
    GLuint m_Vertices{};
 
-   GLsizei m_NumVertices;
+   // The buffer holds [ x... | y... | heat... ] for up to m_Capacity vertices
+   size_t m_Capacity{ 0 };
+
+   GLuint m_PositionXIndex;
+   GLuint m_PositionYIndex;
+   GLuint m_ColorIndex;
+   GLuint m_HeatIndex;
+
+   void reserve( size_t count );
 
    static std::once_flag s_Flag;
-   static std::unique_ptr<Model> s_Instance;
+   static std::unique_ptr<OverlayModel> s_Instance;
 };
@@ -0,0 +1,67 @@
+/*
+MIT License
+
+Copyright (c) 2018 Chris McArthur, prince.chrismc(at)gmail(dot)com
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+#pragma once
+
+#include <mutex>
+#include <memory>
+#include <GL/glew.h>
+#include "ObjectColors.h"
+
+// Draws every particle with a single call, the columns of the universe are streamed into one buffer each frame and the
+// color is a vertex attribute
+class ParticleModel final
+{
+public:
+   ParticleModel( const ParticleModel& ) = delete;
+   ParticleModel( const ParticleModel&& ) = delete;
+   ~ParticleModel();
+
+   void operator=( const ParticleModel& ) = delete;
+   void operator=( const ParticleModel&& ) = delete;
+
+   static ParticleModel& GetInstance();
+
+   void Draw( const float* x, const float* y, const ObjectColors* colors, size_t count );
+
+private:
+   ParticleModel();
+
+   GLuint m_VAO{};
+   GLuint m_Vertices{};
+
+   // The buffer holds [ x... | y... | colors... ] for up to m_Capacity particles
+   size_t m_Capacity{ 0 };
+
+   GLuint m_PositionXIndex;
+   GLuint m_PositionYIndex;
+   GLuint m_ColorIndex;
+   GLuint m_HeatIndex;
+
+   void reserve( size_t count );
+
+   static std::once_flag s_Flag;
+   static std::unique_ptr<ParticleModel> s_Instance;
+};
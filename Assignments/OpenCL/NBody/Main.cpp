@@ -25,6 +25,7 @@ SOFTWARE.
 
 #include "NBody.hpp"
 #include <GL/glut.h>
+#include <sstream>
 
 NBody* nb;
 
@@ -33,6 +34,7 @@ void idle();
 void reShape( int w, int h );
 void displayfunc();
 void keyboardFunc(unsigned char key, int, int );
+int runBenchmarks( int argc, char** argv, const NBody& options );
 
 int main( int argc, char** argv )
 {
@@ -47,9 +49,24 @@ int main( int argc, char** argv )
       std::cout << "Printing!" << std::endl;
    }
 
+   // Every configuration of the sweep gets an instance of its own
+   if( !clNBody.display )
+   {
+      return runBenchmarks( argc, argv, clNBody );
+   }
+
    status = clNBody.setup();
    CHECK_ERROR( status, SDK_SUCCESS, "Failed to setup NBody" );
 
+   // Checks the first step against the host and exits, no display needed
+   if( clNBody.isVerifyEnabled() )
+   {
+      const int verified = clNBody.verifyResults();
+      status = clNBody.cleanup();
+      CHECK_ERROR( status, SDK_SUCCESS, "Sample CleanUP Failed" );
+      return verified;
+   }
+
    if( clNBody.display )
    {
        // Run in  graphical window if requested
@@ -73,6 +90,84 @@ int main( int argc, char** argv )
 }
 
 
+/**
+* @brief Comma separated values, the fallback when the list is empty
+*/
+std::vector<cl_uint> parseSweep( const std::string& list, cl_uint fallback )
+{
+   std::vector<cl_uint> values;
+   std::istringstream stream( list );
+   std::string value;
+   while( std::getline( stream, value, ',' ) )
+   {
+      values.push_back( static_cast<cl_uint>( std::stoul( value ) ) );
+   }
+   if( values.empty() )
+   {
+      values.push_back( fallback );
+   }
+   return values;
+}
+
+/**
+* @brief Headless benchmark of every particle count and work-group size of the sweep, with -e each configuration's
+* first step is verified first
+*/
+int runBenchmarks( int argc, char** argv, const NBody& options )
+{
+   // The particles are rounded to a multiple of the requested size before setupCL may clamp it to the device's limit,
+   // a power of two, so only powers of two stay divisors of the count
+   const std::vector<cl_uint> groupSizes = parseSweep( options.groupSizeSweep, GROUP_SIZE );
+   for( const cl_uint groupSize : groupSizes )
+   {
+      if( groupSize == 0 || ( groupSize & ( groupSize - 1 ) ) != 0 )
+      {
+         std::cout << "The work-group size " << groupSize << " is not a power of two" << std::endl;
+         return SDK_FAILURE;
+      }
+   }
+
+   for( const cl_uint particles : parseSweep( options.particleSweep, options.numParticles ) )
+   {
+      for( const cl_uint groupSize : groupSizes )
+      {
+         const auto setup = [ & ]( NBody& instance )
+         {
+            int status = instance.parseCommandLine( argc, argv );
+            CHECK_ERROR( status, SDK_SUCCESS, "Failed to parse CLI agrs" );
+            instance.numParticles = particles;
+            instance.setGroupSize( groupSize );
+
+            status = instance.setup();
+            CHECK_ERROR( status, SDK_SUCCESS, "Failed to setup NBody" );
+            return SDK_SUCCESS;
+         };
+
+         // On an instance of its own so the timed steps still start from rest
+         if( options.isVerifyEnabled() )
+         {
+            NBody verification;
+            int status = setup( verification );
+            CHECK_ERROR( status, SDK_SUCCESS, "Failed to setup NBody" );
+            const int verified = verification.verifyResults();
+            status = verification.cleanup();
+            CHECK_ERROR( status, SDK_SUCCESS, "Sample CleanUP Failed" );
+            CHECK_ERROR( verified, SDK_SUCCESS, "Verification Failed" );
+         }
+
+         NBody benchmark;
+         int status = setup( benchmark );
+         CHECK_ERROR( status, SDK_SUCCESS, "Failed to setup NBody" );
+         const int measured = benchmark.runBenchmark();
+         status = benchmark.cleanup();
+         CHECK_ERROR( status, SDK_SUCCESS, "Sample CleanUP Failed" );
+         CHECK_ERROR( measured, SDK_SUCCESS, "Benchmark Failed" );
+      }
+   }
+
+   return SDK_SUCCESS;
+}
+
 /**
 * @brief Initialize GL
 */
@@ -130,23 +225,38 @@ void displayfunc()
 
    if( nb->isFirstLuanch )
    {
-       //Calling kernel for calculatig subsequent positions
-      nb->runCLKernels();
+       //Calling kernel for calculatig subsequent positions, the pipelined readback keeps several steps in flight
+      for( int i = 0; i < nb->getPipelineDepth(); i++ )
+      {
+         nb->runCLKernels();
+      }
       nb->isFirstLuanch = false;
       return;
    }
 
 
-   float* pos = nb->getMappedParticlePositions();
+   // The next step runs while this one is drawn, without readback nothing leaves the device
+   const float* pos = nullptr;
+   if( nb->isReadbackEnabled() )
+   {
+      pos = nb->acquireParticlePositions();
+      if( pos == nullptr )
+      {
+         return;
+      }
+   }
    nb->runCLKernels();
-   glBegin( GL_POINTS );
-   for( cl_uint i = 0; i < nb->numParticles; ++i, pos += 4 )
+   if( pos != nullptr )
    {
-      //divided by 300 just for scaling
-      glVertex4f( *pos, *( pos + 1 ), *( pos + 2 ), 300.0f );
+      glBegin( GL_POINTS );
+      for( cl_uint i = 0; i < nb->numParticles; ++i, pos += 4 )
+      {
+         //divided by 300 just for scaling
+         glVertex4f( *pos, *( pos + 1 ), *( pos + 2 ), 300.0f );
+      }
+      glEnd();
+      nb->releaseParticlePositions();
    }
-   glEnd();
-   nb->releaseMappedParticlePositions();
 
    //Calling kernel for calculating subsequent positions
    glFlush();
@@ -16,9 +16,11 @@ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
 
 
 #include "NBody.hpp"
+#include <algorithm>
 #include <cmath>
 #include <malloc.h>
 #include <random>
+#include <vector>
 
 NBody::NBody() : isFirstLuanch( true ), glEvent( nullptr ), display( true ), sampleArgs( true ),
 initPos( nullptr ), initVel( nullptr ), vel( nullptr ), devices( nullptr ), mappedPosBuffer( nullptr ),
@@ -47,8 +49,10 @@ int NBody::setupNBody()
 
    static constexpr const long double PI = 3.141592653589793238462643383279502884L;
 
-   std::random_device rd;
-   std::mt19937 gen( rd() );
+   // random() draws from rand() so both generators are seeded
+   const unsigned int initialSeed = seed != 0 ? seed : headless ? BENCHMARK_SEED : std::random_device{}();
+   std::mt19937 gen( initialSeed );
+   srand( initialSeed );
    std::lognormal_distribution<double> numGenPos( 0.0, 3.8645 );
 
     // initialization of inputs
@@ -130,8 +134,17 @@ int NBody::setupCL()
    {
       // The block is to move the declaration of prop closer to its use
       const cl_command_queue_properties prop = 0;
-      commandQueue = clCreateCommandQueue( context, devices[ sampleArgs.deviceId ], prop, &status );
+      commandQueue = clCreateCommandQueue( context, devices[ sampleArgs.deviceId ], headless ? CL_QUEUE_PROFILING_ENABLE : prop, &status );
       CHECK_OPENCL_ERROR( status, "clCreateCommandQueue failed." );
+
+      // A second in order queue for the readbacks so they run next to the following step
+      if( readbackMode != "pipelined" && readbackMode != "blocking" )
+      {
+         std::cout << "Unknown readback " << readbackMode << ", expected pipelined or blocking" << std::endl;
+         return SDK_FAILURE;
+      }
+      readbackQueue = clCreateCommandQueue( context, devices[ sampleArgs.deviceId ], prop, &status );
+      CHECK_OPENCL_ERROR( status, "clCreateCommandQueue failed. (readbackQueue)" );
    }
 
    //Set device info of given cl_device_id
@@ -167,7 +180,7 @@ int NBody::setupCL()
 
    // create a CL program using the kernel source
    buildProgramData buildData;
-   buildData.kernelName = "NBody_Kernels.cl";
+   buildData.kernelName = kernelType == "tree" ? "NBody_Tree_Kernels.cl" : "NBody_Kernels.cl";
    buildData.devices = devices;
    buildData.deviceId = sampleArgs.deviceId;
    buildData.flagsStr.clear();
@@ -185,73 +198,388 @@ int NBody::setupCL()
    CHECK_ERROR( retValue, SDK_SUCCESS, "buildOpenCLProgram() failed" );
 
    // get a kernel object handle for a kernel with the given name
-   kernel = clCreateKernel( program, "nbody_sim", &status );
-   CHECK_OPENCL_ERROR( status, "clCreateKernel failed." );
+   if( kernelType != "simple" && kernelType != "tiled" && kernelType != "tree" )
+   {
+      std::cout << "Unknown kernel " << kernelType << ", expected simple, tiled or tree" << std::endl;
+      return SDK_FAILURE;
+   }
+   if( kernelType == "tree" )
+   {
+      return setupTreeCL();
+   }
+   for( cl_kernel& kernel : kernels )
+   {
+      kernel = clCreateKernel( program, kernelType == "tiled" ? "nbody_sim_tiled" : "nbody_sim", &status );
+      CHECK_OPENCL_ERROR( status, "clCreateKernel failed." );
+   }
+
+   retValue = kernelInfo.setKernelWorkGroupInfo( kernels[ 0 ], devices[ sampleArgs.deviceId ] );
+   CHECK_ERROR( retValue, SDK_SUCCESS, "setKernelWorkGroupInfo() failed" );
+
+   // CPU runtimes may cap the work-group below GROUP_SIZE, both are powers of two so numParticles stays a multiple of it
+   if( groupSize > kernelInfo.kernelWorkGroupSize )
+   {
+      std::cout << "Out of resources, reducing the work-group size from " << groupSize << " to " << kernelInfo.kernelWorkGroupSize << std::endl;
+      groupSize = kernelInfo.kernelWorkGroupSize;
+   }
+
+   if( kernelType == "tiled" && kernelInfo.localMemoryUsed + groupSize * sizeof( cl_float4 ) > deviceInfo.localMemSize )
+   {
+      std::cout << "The tile of " << groupSize << " positions does not fit in the device's local memory" << std::endl;
+      return SDK_FAILURE;
+   }
+
+   return SDK_SUCCESS;
+}
+
+
+const char* const NBody::treeKernelNames[ TREE_KERNELS ] = { "bounding_box", "bounding_box_final", "morton_keys", "bitonic_sort", "build_tree",
+                                                             "summarize", "tree_force" };
+
+int NBody::setupTreeCL()
+{
+   cl_int status = CL_SUCCESS;
+   for( int i = 0; i < TREE_KERNELS; i++ )
+   {
+      treeKernels[ i ] = clCreateKernel( program, treeKernelNames[ i ], &status );
+      CHECK_OPENCL_ERROR( status, "clCreateKernel failed. (treeKernels)" );
+   }
+
+   int retValue = kernelInfo.setKernelWorkGroupInfo( treeKernels[ TREE_FORCE ], devices[ sampleArgs.deviceId ] );
+   CHECK_ERROR( retValue, SDK_SUCCESS, "setKernelWorkGroupInfo() failed" );
+   if( groupSize > kernelInfo.kernelWorkGroupSize )
+   {
+      std::cout << "Out of resources, reducing the work-group size from " << groupSize << " to " << kernelInfo.kernelWorkGroupSize << std::endl;
+      groupSize = kernelInfo.kernelWorkGroupSize;
+   }
+
+   // The bitonic sort needs a power of two
+   paddedParticles = 1;
+   while( paddedParticles < numParticles )
+   {
+      paddedParticles <<= 1;
+   }
+
+   const size_t sizes[ TREE_BUFFERS ] = {
+      REDUCE_SIZE * sizeof( cl_float4 ),     // PARTIAL_MIN
+      REDUCE_SIZE * sizeof( cl_float4 ),     // PARTIAL_MAX
+      2 * sizeof( cl_float4 ),               // BOX
+      paddedParticles * sizeof( cl_ulong ),  // MORTON_KEYS
+      paddedParticles * sizeof( cl_uint ),   // SORTED_ORDER
+      2 * numParticles * sizeof( cl_int ),   // CHILDREN, two per internal node
+      numParticles * sizeof( cl_int ),       // INTERNAL_PARENT
+      numParticles * sizeof( cl_int ),       // LEAF_PARENT
+      numParticles * sizeof( cl_int ),       // NODE_FLAGS
+      numParticles * sizeof( cl_float4 ),    // NODE_COM
+      numParticles * sizeof( cl_float4 ),    // NODE_MIN
+      numParticles * sizeof( cl_float4 ),    // NODE_MAX
+   };
+   for( int i = 0; i < TREE_BUFFERS; i++ )
+   {
+      treeBuffers[ i ] = clCreateBuffer( context, CL_MEM_READ_WRITE, sizes[ i ], nullptr, &status );
+      CHECK_OPENCL_ERROR( status, "clCreateBuffer failed. (treeBuffers)" );
+   }
 
    return SDK_SUCCESS;
 }
 
+// Everything but the position and velocity buffers and the sort pass stays the same between frames
+int NBody::setupTreeCLKernels() const
+{
+   const cl_uint reduceSize = REDUCE_SIZE;
+   const cl_float thetaSqr = theta * theta;
+
+   struct Arg { TreeKernel kernel; cl_uint index; size_t size; const void* value; };
+   const Arg args[] = {
+      { BOUNDING_BOX, 1, sizeof( cl_uint ), &numParticles },
+      { BOUNDING_BOX, 2, sizeof( cl_mem ), &treeBuffers[ PARTIAL_MIN ] },
+      { BOUNDING_BOX, 3, sizeof( cl_mem ), &treeBuffers[ PARTIAL_MAX ] },
+      { BOUNDING_BOX_FINAL, 0, sizeof( cl_mem ), &treeBuffers[ PARTIAL_MIN ] },
+      { BOUNDING_BOX_FINAL, 1, sizeof( cl_mem ), &treeBuffers[ PARTIAL_MAX ] },
+      { BOUNDING_BOX_FINAL, 2, sizeof( cl_uint ), &reduceSize },
+      { BOUNDING_BOX_FINAL, 3, sizeof( cl_mem ), &treeBuffers[ BOX ] },
+      { MORTON_KEYS, 1, sizeof( cl_uint ), &numParticles },
+      { MORTON_KEYS, 2, sizeof( cl_mem ), &treeBuffers[ BOX ] },
+      { MORTON_KEYS, 3, sizeof( cl_mem ), &treeBuffers[ MORTON_KEYS_BUFFER ] },
+      { MORTON_KEYS, 4, sizeof( cl_mem ), &treeBuffers[ SORTED_ORDER ] },
+      { BITONIC_SORT, 0, sizeof( cl_mem ), &treeBuffers[ MORTON_KEYS_BUFFER ] },
+      { BITONIC_SORT, 1, sizeof( cl_mem ), &treeBuffers[ SORTED_ORDER ] },
+      { BUILD_TREE, 0, sizeof( cl_mem ), &treeBuffers[ MORTON_KEYS_BUFFER ] },
+      { BUILD_TREE, 1, sizeof( cl_uint ), &numParticles },
+      { BUILD_TREE, 2, sizeof( cl_mem ), &treeBuffers[ CHILDREN ] },
+      { BUILD_TREE, 3, sizeof( cl_mem ), &treeBuffers[ INTERNAL_PARENT ] },
+      { BUILD_TREE, 4, sizeof( cl_mem ), &treeBuffers[ LEAF_PARENT ] },
+      { BUILD_TREE, 5, sizeof( cl_mem ), &treeBuffers[ NODE_FLAGS ] },
+      { SUMMARIZE, 1, sizeof( cl_mem ), &treeBuffers[ SORTED_ORDER ] },
+      { SUMMARIZE, 2, sizeof( cl_uint ), &numParticles },
+      { SUMMARIZE, 3, sizeof( cl_mem ), &treeBuffers[ CHILDREN ] },
+      { SUMMARIZE, 4, sizeof( cl_mem ), &treeBuffers[ INTERNAL_PARENT ] },
+      { SUMMARIZE, 5, sizeof( cl_mem ), &treeBuffers[ LEAF_PARENT ] },
+      { SUMMARIZE, 6, sizeof( cl_mem ), &treeBuffers[ NODE_FLAGS ] },
+      { SUMMARIZE, 7, sizeof( cl_mem ), &treeBuffers[ NODE_COM ] },
+      { SUMMARIZE, 8, sizeof( cl_mem ), &treeBuffers[ NODE_MIN ] },
+      { SUMMARIZE, 9, sizeof( cl_mem ), &treeBuffers[ NODE_MAX ] },
+      { TREE_FORCE, 2, sizeof( cl_mem ), &treeBuffers[ SORTED_ORDER ] },
+      { TREE_FORCE, 3, sizeof( cl_uint ), &numParticles },
+      { TREE_FORCE, 4, sizeof( cl_float ), &delT },
+      { TREE_FORCE, 5, sizeof( cl_float ), &espSqr },
+      { TREE_FORCE, 6, sizeof( cl_float ), &thetaSqr },
+      { TREE_FORCE, 7, sizeof( cl_mem ), &treeBuffers[ CHILDREN ] },
+      { TREE_FORCE, 8, sizeof( cl_mem ), &treeBuffers[ NODE_COM ] },
+      { TREE_FORCE, 9, sizeof( cl_mem ), &treeBuffers[ NODE_MIN ] },
+      { TREE_FORCE, 10, sizeof( cl_mem ), &treeBuffers[ NODE_MAX ] },
+   };
+
+   for( const Arg& arg : args )
+   {
+      const cl_int status = clSetKernelArg( treeKernels[ arg.kernel ], arg.index, arg.size, arg.value );
+      CHECK_OPENCL_ERROR( status, "clSetKernelArg failed. (treeKernels)" );
+   }
+
+   return SDK_SUCCESS;
+}
+
+// Rebuilds the tree from the current positions and steps every body with it, the kernels run in order on the queue and
+// are flushed with the rest of the frame by runCLKernels
+int NBody::runTreeKernels( int currentBuffer, int nextBuffer )
+{
+   const size_t reduceThreads[] = { REDUCE_SIZE };
+   const size_t singleThread[] = { 1 };
+   const size_t paddedThreads[] = { paddedParticles };
+   const size_t bodyThreads[] = { numParticles };
+   const size_t localThreads[] = { groupSize };
+
+   cl_int status = clSetKernelArg( treeKernels[ BOUNDING_BOX ], 0, sizeof( cl_mem ), particlePos + currentBuffer );
+   CHECK_OPENCL_ERROR( status, "clSetKernelArg failed. (bounding_box)" );
+   status = clEnqueueNDRangeKernel( commandQueue, treeKernels[ BOUNDING_BOX ], 1, nullptr, reduceThreads, nullptr, 0, nullptr, profileEvent( treeKernelNames[ BOUNDING_BOX ] ) );
+   CHECK_OPENCL_ERROR( status, "clEnqueueNDRangeKernel failed. (bounding_box)" );
+   status = clEnqueueNDRangeKernel( commandQueue, treeKernels[ BOUNDING_BOX_FINAL ], 1, nullptr, singleThread, nullptr, 0, nullptr, profileEvent( treeKernelNames[ BOUNDING_BOX_FINAL ] ) );
+   CHECK_OPENCL_ERROR( status, "clEnqueueNDRangeKernel failed. (bounding_box_final)" );
+
+   status = clSetKernelArg( treeKernels[ MORTON_KEYS ], 0, sizeof( cl_mem ), particlePos + currentBuffer );
+   CHECK_OPENCL_ERROR( status, "clSetKernelArg failed. (morton_keys)" );
+   status = clEnqueueNDRangeKernel( commandQueue, treeKernels[ MORTON_KEYS ], 1, nullptr, paddedThreads, nullptr, 0, nullptr, profileEvent( treeKernelNames[ MORTON_KEYS ] ) );
+   CHECK_OPENCL_ERROR( status, "clEnqueueNDRangeKernel failed. (morton_keys)" );
+
+   // The arguments are captured when the pass is enqueued so they can be changed for the next one right away
+   for( cl_uint k = 2; k <= paddedParticles; k <<= 1 )
+   {
+      for( cl_uint j = k >> 1; j > 0; j >>= 1 )
+      {
+         status = clSetKernelArg( treeKernels[ BITONIC_SORT ], 2, sizeof( cl_uint ), &j );
+         CHECK_OPENCL_ERROR( status, "clSetKernelArg failed. (bitonic_sort)" );
+         status = clSetKernelArg( treeKernels[ BITONIC_SORT ], 3, sizeof( cl_uint ), &k );
+         CHECK_OPENCL_ERROR( status, "clSetKernelArg failed. (bitonic_sort)" );
+         status = clEnqueueNDRangeKernel( commandQueue, treeKernels[ BITONIC_SORT ], 1, nullptr, paddedThreads, nullptr, 0, nullptr, profileEvent( treeKernelNames[ BITONIC_SORT ] ) );
+         CHECK_OPENCL_ERROR( status, "clEnqueueNDRangeKernel failed. (bitonic_sort)" );
+      }
+   }
+
+   status = clEnqueueNDRangeKernel( commandQueue, treeKernels[ BUILD_TREE ], 1, nullptr, bodyThreads, nullptr, 0, nullptr, profileEvent( treeKernelNames[ BUILD_TREE ] ) );
+   CHECK_OPENCL_ERROR( status, "clEnqueueNDRangeKernel failed. (build_tree)" );
+
+   status = clSetKernelArg( treeKernels[ SUMMARIZE ], 0, sizeof( cl_mem ), particlePos + currentBuffer );
+   CHECK_OPENCL_ERROR( status, "clSetKernelArg failed. (summarize)" );
+   status = clEnqueueNDRangeKernel( commandQueue, treeKernels[ SUMMARIZE ], 1, nullptr, bodyThreads, nullptr, 0, nullptr, profileEvent( treeKernelNames[ SUMMARIZE ] ) );
+   CHECK_OPENCL_ERROR( status, "clEnqueueNDRangeKernel failed. (summarize)" );
+
+   const cl_mem forceArgs[ 4 ] = { particlePos[ currentBuffer ], particleVel[ currentBuffer ], particlePos[ nextBuffer ], particleVel[ nextBuffer ] };
+   const cl_uint forceIndices[ 4 ] = { 0, 1, 11, 12 };
+   for( int i = 0; i < 4; i++ )
+   {
+      status = clSetKernelArg( treeKernels[ TREE_FORCE ], forceIndices[ i ], sizeof( cl_mem ), forceArgs + i );
+      CHECK_OPENCL_ERROR( status, "clSetKernelArg failed. (tree_force)" );
+   }
+   status = clEnqueueNDRangeKernel( commandQueue, treeKernels[ TREE_FORCE ], 1, nullptr, bodyThreads, localThreads, 0, nullptr, profileEvent( treeKernelNames[ TREE_FORCE ] ) );
+   CHECK_OPENCL_ERROR( status, "clEnqueueNDRangeKernel failed. (tree_force)" );
+
+   return SDK_SUCCESS;
+}
 
 // Set appropriate arguments to the kernel
 int NBody::setupCLKernels() const
 {
-   // numParticles
-   cl_int status = clSetKernelArg( kernel, 2, sizeof( cl_uint ), &numParticles );
-   CHECK_OPENCL_ERROR( status, "clSetKernelArg failed. (numParticles)" );
+   if( kernelType == "tree" )
+   {
+      return setupTreeCLKernels();
+   }
+
+   // The two kernels only differ in the direction of the ping-pong, so a step sets no argument at all
+   for( int current = 0; current < 2; current++ )
+   {
+      const cl_kernel kernel = kernels[ current ];
+      const int next = ( current + 1 ) % 2;
+
+      // Particle positions
+      cl_int status = clSetKernelArg( kernel, 0, sizeof( cl_mem ), particlePos + current );
+      CHECK_OPENCL_ERROR( status, "clSetKernelArg failed. (updatedPos)" );
+
+      // Particle velocity
+      status = clSetKernelArg( kernel, 1, sizeof( cl_mem ), particleVel + current );
+      CHECK_OPENCL_ERROR( status, "clSetKernelArg failed. (updatedVel)" );
 
-   // time step
-   status = clSetKernelArg( kernel, 3, sizeof( cl_float ), &delT );
-   CHECK_OPENCL_ERROR( status, "clSetKernelArg failed. (delT)" );
+      // numParticles
+      status = clSetKernelArg( kernel, 2, sizeof( cl_uint ), &numParticles );
+      CHECK_OPENCL_ERROR( status, "clSetKernelArg failed. (numParticles)" );
 
-   // upward Pseudoprobability
-   status = clSetKernelArg( kernel, 4, sizeof( cl_float ), &espSqr );
-   CHECK_OPENCL_ERROR( status, "clSetKernelArg failed. (espSqr)" );
+      // time step
+      status = clSetKernelArg( kernel, 3, sizeof( cl_float ), &delT );
+      CHECK_OPENCL_ERROR( status, "clSetKernelArg failed. (delT)" );
+
+      // upward Pseudoprobability
+      status = clSetKernelArg( kernel, 4, sizeof( cl_float ), &espSqr );
+      CHECK_OPENCL_ERROR( status, "clSetKernelArg failed. (espSqr)" );
+
+      // Particle positions
+      status = clSetKernelArg( kernel, 5, sizeof( cl_mem ), particlePos + next );
+      CHECK_OPENCL_ERROR( status, "clSetKernelArg failed. (unewPos)" );
+
+      // Particle velocity
+      status = clSetKernelArg( kernel, 6, sizeof( cl_mem ), particleVel + next );
+      CHECK_OPENCL_ERROR( status, "clSetKernelArg failed. (newVel)" );
+
+      // one tile of positions per work-group
+      if( kernelType == "tiled" )
+      {
+         status = clSetKernelArg( kernel, 7, groupSize * sizeof( cl_float4 ), nullptr );
+         CHECK_OPENCL_ERROR( status, "clSetKernelArg failed. (localPos)" );
+      }
+   }
 
    return SDK_SUCCESS;
 }
 
 
 int NBody::runCLKernels()
+{
+   // Offline runs enqueue several steps per frame, only the positions of the last one leave the device
+   const cl_uint steps = std::max( stepsPerReadback, 1u );
+   for( cl_uint i = 0; i < steps; i++ )
+   {
+      CHECK_ERROR( enqueueStep(), SDK_SUCCESS, "enqueueStep() failed" );
+   }
+
+   if( readbackMode == "pipelined" && isReadbackEnabled() )
+   {
+      CHECK_ERROR( enqueueReadback( currentPosBufferIndex ), SDK_SUCCESS, "enqueueReadback() failed" );
+   }
+   else
+   {
+      const cl_int status = clFlush( commandQueue );
+      CHECK_OPENCL_ERROR( status, "clFlush failed." );
+   }
+
+   timerNumFrames++;
+
+   return SDK_SUCCESS;
+}
+
+int NBody::enqueueStep()
 {
    const int currentBuffer = currentPosBufferIndex;
    const int nextBuffer = ( currentPosBufferIndex + 1 ) % 2;
 
-   /*
-   * Enqueue a kernel run call.
-   */
-   size_t globalThreads[] = { numParticles };
-   size_t localThreads[] = { groupSize };
+   // The step overwrites the positions read back two steps ago, only the transfer has to be done
+   if( bufferRead[ nextBuffer ] )
+   {
+      cl_int status = clEnqueueBarrierWithWaitList( commandQueue, 1, bufferRead + nextBuffer, nullptr );
+      CHECK_OPENCL_ERROR( status, "clEnqueueBarrierWithWaitList failed." );
+      clReleaseEvent( bufferRead[ nextBuffer ] );
+      bufferRead[ nextBuffer ] = nullptr;
+   }
 
-   // Particle positions
-   cl_int status = clSetKernelArg( kernel, 0, sizeof( cl_mem ), particlePos + currentBuffer );
-   CHECK_OPENCL_ERROR( status, "clSetKernelArg failed. (updatedPos)" );
+   if( kernelType == "tree" )
+   {
+      CHECK_ERROR( runTreeKernels( currentBuffer, nextBuffer ), SDK_SUCCESS, "runTreeKernels() failed" );
+   }
+   else
+   {
+      /*
+      * Enqueue a kernel run call.
+      */
+      size_t globalThreads[] = { numParticles };
+      size_t localThreads[] = { groupSize };
+
+      const cl_int status = clEnqueueNDRangeKernel( commandQueue, kernels[ currentBuffer ], 1, nullptr, globalThreads, localThreads, 0, nullptr,
+                                                    profileEvent( kernelType == "tiled" ? "nbody_sim_tiled" : "nbody_sim" ) );
+      CHECK_OPENCL_ERROR( status, "clEnqueueNDRangeKernel failed." );
+   }
 
-   // Particle velocity
-   status = clSetKernelArg( kernel, 1, sizeof( cl_mem ), particleVel + currentBuffer );
-   CHECK_OPENCL_ERROR( status, "clSetKernelArg failed. (updatedVel)" );
+   currentPosBufferIndex = nextBuffer;
 
-   // Particle positions
-   status = clSetKernelArg( kernel, 5, sizeof( cl_mem ), particlePos + nextBuffer );
-   CHECK_OPENCL_ERROR( status, "clSetKernelArg failed. (unewPos)" );
+   return SDK_SUCCESS;
+}
 
-   // Particle velocity
-   status = clSetKernelArg( kernel, 6, sizeof( cl_mem ), particleVel + nextBuffer );
-   CHECK_OPENCL_ERROR( status, "clSetKernelArg failed. (newVel)" );
+cl_event* NBody::profileEvent( const char* name )
+{
+   if( !headless )
+   {
+      return nullptr;
+   }
+
+   // Filled in by the enqueue before the next launch can move it
+   kernelEvents.emplace_back( name, nullptr );
+   return &kernelEvents.back().second;
+}
 
-   status = clEnqueueNDRangeKernel( commandQueue, kernel, 1, nullptr, globalThreads, localThreads, 0, nullptr, nullptr );
-   CHECK_OPENCL_ERROR( status, "clEnqueueNDRangeKernel failed." );
+int NBody::enqueueReadback( int buffer )
+{
+   if( readbacksPending == READBACK_SLOTS )
+   {
+      std::cout << "Every readback slot is in use, release the positions before running the next step" << std::endl;
+      return SDK_FAILURE;
+   }
 
+   // The compute queue is in order, the marker completes with the step
+   cl_event stepDone = nullptr;
+   cl_int status = clEnqueueMarkerWithWaitList( commandQueue, 0, nullptr, &stepDone );
+   CHECK_OPENCL_ERROR( status, "clEnqueueMarkerWithWaitList failed." );
    status = clFlush( commandQueue );
    CHECK_OPENCL_ERROR( status, "clFlush failed." );
 
-   currentPosBufferIndex = nextBuffer;
-   timerNumFrames++;
+   Readback& slot = readbacks[ readbackHead ];
+   slot.positions.resize( numParticles * 4 );
+   status = clEnqueueReadBuffer( readbackQueue, particlePos[ buffer ], CL_FALSE, 0, numParticles * sizeof( cl_float4 ), slot.positions.data(),
+                                 1, &stepDone, &slot.ready );
+   clReleaseEvent( stepDone );
+   CHECK_OPENCL_ERROR( status, "clEnqueueReadBuffer failed. (readback)" );
+
+   status = clRetainEvent( slot.ready );
+   CHECK_OPENCL_ERROR( status, "clRetainEvent failed. (readback)" );
+   bufferRead[ buffer ] = slot.ready;
 
+   status = clFlush( readbackQueue );
+   CHECK_OPENCL_ERROR( status, "clFlush failed. (readbackQueue)" );
+
+   readbackHead = ( readbackHead + 1 ) % READBACK_SLOTS;
+   readbacksPending++;
    return SDK_SUCCESS;
 }
 
-float* NBody::getMappedParticlePositions()
+int NBody::getPipelineDepth() const
 {
+   return readbackMode == "pipelined" ? READBACK_DEPTH : 1;
+}
+
+const float* NBody::acquireParticlePositions()
+{
+   if( readbackMode == "pipelined" )
+   {
+      // Only the oldest step is waited on, the newer ones keep the device busy
+      if( readbacksPending == 0 )
+      {
+         return nullptr;
+      }
+
+      Readback& slot = readbacks[ ( readbackHead + READBACK_SLOTS - readbacksPending ) % READBACK_SLOTS ];
+      if( clWaitForEvents( 1, &slot.ready ) != CL_SUCCESS )
+      {
+         return nullptr;
+      }
+      mappedPosBuffer = slot.positions.data();
+      return mappedPosBuffer;
+   }
+
    cl_int status;
    mappedPosBufferIndex = currentPosBufferIndex;
    mappedPosBuffer = static_cast<float*>( clEnqueueMapBuffer( commandQueue, particlePos[ mappedPosBufferIndex ], CL_TRUE, CL_MAP_READ,
@@ -259,14 +587,175 @@ float* NBody::getMappedParticlePositions()
    return mappedPosBuffer;
 }
 
-void NBody::releaseMappedParticlePositions()
+void NBody::releaseParticlePositions()
 {
-   if( mappedPosBuffer )
+   if( !mappedPosBuffer )
+   {
+      return;
+   }
+
+   if( readbackMode == "pipelined" )
+   {
+      Readback& slot = readbacks[ ( readbackHead + READBACK_SLOTS - readbacksPending ) % READBACK_SLOTS ];
+      clReleaseEvent( slot.ready );
+      slot.ready = nullptr;
+      readbacksPending--;
+   }
+   else
    {
       clEnqueueUnmapMemObject( commandQueue, particlePos[ mappedPosBufferIndex ], mappedPosBuffer, 0, nullptr, nullptr );
-      mappedPosBuffer = nullptr;
       clFlush( commandQueue );
    }
+   mappedPosBuffer = nullptr;
+}
+
+int NBody::verifyResults()
+{
+   // The first step starts from initPos at rest
+   if( enqueueStep() != SDK_SUCCESS )
+   {
+      return SDK_FAILURE;
+   }
+
+   // From rest the new velocity is exactly acceleration * dt, unlike the positions it carries no large offset that
+   // would hide the error of the acceleration
+   std::vector<cl_float> result( numParticles * 4 );
+   cl_int status = clEnqueueReadBuffer( commandQueue, particleVel[ currentPosBufferIndex ], CL_TRUE, 0, numParticles * sizeof( cl_float4 ),
+                                        result.data(), 0, nullptr, nullptr );
+   CHECK_OPENCL_ERROR( status, "clEnqueueReadBuffer failed. (particleVel)" );
+
+   // Summed in double, every particle's relative error is held to VERIFY_TOLERANCE which covers the kernels' float
+   // accumulation in any order. The tree approximates the far field so it is held to the RMS of the relative error
+   size_t mismatches = 0;
+   double squaredError = 0.0;
+   for( cl_uint i = 0; i < numParticles; ++i )
+   {
+      double acc[ 3 ] = { 0.0, 0.0, 0.0 };
+      for( cl_uint j = 0; j < numParticles; ++j )
+      {
+         double r[ 3 ];
+         for( int k = 0; k < 3; ++k )
+         {
+            r[ k ] = static_cast<double>( initPos[ 4 * j + k ] ) - initPos[ 4 * i + k ];
+         }
+
+         const double invDist = 1.0 / std::sqrt( r[ 0 ] * r[ 0 ] + r[ 1 ] * r[ 1 ] + r[ 2 ] * r[ 2 ] + espSqr );
+         const double s = initPos[ 4 * j + 3 ] * invDist * invDist * invDist;
+         for( int k = 0; k < 3; ++k )
+         {
+            acc[ k ] += s * r[ k ];
+         }
+      }
+
+      double error = 0.0;
+      double norm = 0.0;
+      for( int k = 0; k < 3; ++k )
+      {
+         const double expected = acc[ k ] * delT;
+         const double actual = result[ 4 * i + k ];
+         error += ( actual - expected ) * ( actual - expected );
+         norm += expected * expected;
+      }
+      const double relativeError = norm > 0.0 ? error / norm : error > 0.0 ? 1.0 : 0.0;
+      if( relativeError > VERIFY_TOLERANCE * VERIFY_TOLERANCE )
+      {
+         mismatches++;
+      }
+      squaredError += relativeError;
+   }
+
+   const double rmsError = std::sqrt( squaredError / numParticles );
+   const bool passed = kernelType == "tree" ? rmsError < TREE_TOLERANCE : mismatches == 0;
+   std::cout << ( passed ? "Passed!" : "Failed!" ) << " " << kernelType << " kernel, " << mismatches << " mismatching particles, RMS relative error "
+             << rmsError << std::endl;
+   return passed ? SDK_SUCCESS : SDK_FAILURE;
+}
+
+int NBody::runBenchmark()
+{
+   // The first launch pays for the runtime's lazy compilation and allocations
+   CHECK_ERROR( enqueueStep(), SDK_SUCCESS, "enqueueStep() failed" );
+   cl_int status = clFinish( commandQueue );
+   CHECK_OPENCL_ERROR( status, "clFinish failed." );
+   releaseKernelEvents();
+
+   const cl_uint perFrame = std::max( stepsPerReadback, 1u );
+   const cl_uint frames = std::max( ( benchmarkSteps + perFrame - 1 ) / perFrame, 1u );
+   const cl_uint steps = frames * perFrame;
+
+   const int timer = sampleTimer.createTimer();
+   sampleTimer.resetTimer( timer );
+   sampleTimer.startTimer( timer );
+   for( cl_uint frame = 0; frame < frames; frame++ )
+   {
+      // The positions are consumed like the display does, the pipelined readback keeps READBACK_DEPTH frames in flight
+      if( isReadbackEnabled() && ( readbackMode != "pipelined" || readbacksPending == READBACK_DEPTH ) )
+      {
+         if( acquireParticlePositions() == nullptr )
+         {
+            std::cout << "Failed to acquire the particle positions" << std::endl;
+            return SDK_FAILURE;
+         }
+         releaseParticlePositions();
+      }
+      CHECK_ERROR( runCLKernels(), SDK_SUCCESS, "runCLKernels() failed" );
+   }
+   status = clFinish( commandQueue );
+   CHECK_OPENCL_ERROR( status, "clFinish failed." );
+   status = clFinish( readbackQueue );
+   CHECK_OPENCL_ERROR( status, "clFinish failed. (readbackQueue)" );
+   sampleTimer.stopTimer( timer );
+   const double wallSeconds = sampleTimer.readTimer( timer );
+
+   // Summed per kernel in the order they first ran, the tree launches several per step
+   struct KernelTime { std::string name; size_t launches; double seconds; };
+   std::vector<KernelTime> times;
+   double deviceSeconds = 0.0;
+   for( const auto& launch : kernelEvents )
+   {
+      cl_ulong start = 0;
+      cl_ulong end = 0;
+      status = clGetEventProfilingInfo( launch.second, CL_PROFILING_COMMAND_START, sizeof( cl_ulong ), &start, nullptr );
+      CHECK_OPENCL_ERROR( status, "clGetEventProfilingInfo failed. (start)" );
+      status = clGetEventProfilingInfo( launch.second, CL_PROFILING_COMMAND_END, sizeof( cl_ulong ), &end, nullptr );
+      CHECK_OPENCL_ERROR( status, "clGetEventProfilingInfo failed. (end)" );
+
+      auto time = std::find_if( times.begin(), times.end(), [ &launch ]( const KernelTime& t ) { return t.name == launch.first; } );
+      if( time == times.end() )
+      {
+         time = times.insert( times.end(), KernelTime{ launch.first, 0, 0.0 } );
+      }
+      time->launches++;
+      time->seconds += ( end - start ) * 1e-9;
+      deviceSeconds += ( end - start ) * 1e-9;
+   }
+   releaseKernelEvents();
+
+   // KERNEL_FLOPS are per pair of bodies, the tree is reported as the direct sum it replaces
+   const double interactions = static_cast<double>( numParticles ) * numParticles * steps;
+   std::cout << kernelType << " kernel, " << numParticles << " particles, work-group " << groupSize << ", " << steps << " steps, "
+             << perFrame << " per readback" << std::endl;
+   for( const KernelTime& time : times )
+   {
+      std::cout << "   " << time.name << ": " << time.launches << " launches, " << time.seconds * 1e3 / steps << " ms/step" << std::endl;
+   }
+   std::cout << "   device " << deviceSeconds * 1e3 / steps << " ms/step, wall " << wallSeconds * 1e3 / steps << " ms/step, "
+             << interactions * KERNEL_FLOPS / deviceSeconds * 1e-9 << " GFLOP/s, " << interactions / deviceSeconds << " interactions/s"
+             << ( kernelType == "tree" ? " ( direct sum equivalent )" : "" ) << std::endl;
+
+   return SDK_SUCCESS;
+}
+
+void NBody::releaseKernelEvents()
+{
+   for( const auto& launch : kernelEvents )
+   {
+      if( launch.second )
+      {
+         clReleaseEvent( launch.second );
+      }
+   }
+   kernelEvents.clear();
 }
 
 int NBody::initialize()
@@ -280,6 +769,33 @@ int NBody::initialize()
    auto num_particles = Option{ "x","particles","Number of particles", "" , CA_ARG_INT , &numParticles };
    sampleArgs.AddOption( &num_particles );
 
+   auto kernel_type = Option{ "k","kernel","Kernel to run, simple, tiled ( local memory ) or tree ( Barnes-Hut )", "" , CA_ARG_STRING , &kernelType };
+   sampleArgs.AddOption( &kernel_type );
+
+   auto readback = Option{ "r","readback","Position readback, pipelined ( non-blocking into a ring of host buffers ) or blocking ( map every frame )", "" , CA_ARG_STRING , &readbackMode };
+   sampleArgs.AddOption( &readback );
+
+   auto steps_per_readback = Option{ "s","stepsPerReadback","Steps enqueued back to back per frame, only the last one is read back, 0 never reads back", "" , CA_ARG_INT , &stepsPerReadback };
+   sampleArgs.AddOption( &steps_per_readback );
+
+   auto no_display = Option{ "","no-display","Run the benchmark without a window, kernels are timed with a profiling queue", "" , CA_NO_ARGUMENT , &headless };
+   sampleArgs.AddOption( &no_display );
+
+   auto steps = Option{ "","steps","Steps timed by the benchmark", "" , CA_ARG_INT , &benchmarkSteps };
+   sampleArgs.AddOption( &steps );
+
+   auto initial_seed = Option{ "","seed","Seed of the initial conditions, the benchmark uses the same one every run by default", "" , CA_ARG_INT , &seed };
+   sampleArgs.AddOption( &initial_seed );
+
+   auto particle_sweep = Option{ "","sweepParticles","Comma separated particle counts the benchmark runs", "" , CA_ARG_STRING , &particleSweep };
+   sampleArgs.AddOption( &particle_sweep );
+
+   auto group_size_sweep = Option{ "","sweepGroupSizes","Comma separated work-group sizes the benchmark runs", "" , CA_ARG_STRING , &groupSizeSweep };
+   sampleArgs.AddOption( &group_size_sweep );
+
+   auto opening_angle = Option{ "a","theta","Opening angle of the tree kernel", "" , CA_ARG_FLOAT , &theta };
+   sampleArgs.AddOption( &opening_angle );
+
    return SDK_SUCCESS;
 }
 
@@ -307,8 +823,48 @@ double NBody::getFPS()
 
 int NBody::cleanup()
 {
-   cl_int status = clReleaseKernel( kernel );
-   CHECK_OPENCL_ERROR( status, "clReleaseKernel failed.(kernel)" );
+   // Nothing may still be writing into the readback slots
+   cl_int status = clFinish( readbackQueue );
+   CHECK_OPENCL_ERROR( status, "clFinish failed.(readbackQueue)" );
+   for( Readback& slot : readbacks )
+   {
+      if( slot.ready )
+      {
+         clReleaseEvent( slot.ready );
+         slot.ready = nullptr;
+      }
+   }
+   for( cl_event& read : bufferRead )
+   {
+      if( read )
+      {
+         clReleaseEvent( read );
+         read = nullptr;
+      }
+   }
+   readbacksPending = 0;
+   releaseKernelEvents();
+   if( kernelType == "tree" )
+   {
+      for( cl_kernel treeKernel : treeKernels )
+      {
+         status = clReleaseKernel( treeKernel );
+         CHECK_OPENCL_ERROR( status, "clReleaseKernel failed.(treeKernels)" );
+      }
+      for( cl_mem treeBuffer : treeBuffers )
+      {
+         status = clReleaseMemObject( treeBuffer );
+         CHECK_OPENCL_ERROR( status, "clReleaseMemObject failed.(treeBuffers)" );
+      }
+   }
+   else
+   {
+      for( cl_kernel kernel : kernels )
+      {
+         status = clReleaseKernel( kernel );
+         CHECK_OPENCL_ERROR( status, "clReleaseKernel failed.(kernel)" );
+      }
+   }
 
    status = clReleaseProgram( program );
    CHECK_OPENCL_ERROR( status, "clReleaseProgram failed.(program)" );
@@ -324,6 +880,9 @@ int NBody::cleanup()
    status = clReleaseCommandQueue( commandQueue );
    CHECK_OPENCL_ERROR( status, "clReleaseCommandQueue failed.(commandQueue)" );
 
+   status = clReleaseCommandQueue( readbackQueue );
+   CHECK_OPENCL_ERROR( status, "clReleaseCommandQueue failed.(readbackQueue)" );
+
    status = clReleaseContext( context );
    CHECK_OPENCL_ERROR( status, "clReleaseContext failed.(context)" );
 
@@ -352,5 +911,7 @@ NBody::~NBody()
 
 int NBody::parseCommandLine( int argc, char** argv )
 {
-   return sampleArgs.parseCommandLine( argc, argv );
+   const int status = sampleArgs.parseCommandLine( argc, argv );
+   display = !headless;
+   return status;
 }
@@ -19,12 +19,33 @@ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
 #define NBODY_H_
 
 #include "CLUtil.hpp"
+#include <string>
+#include <utility>
+#include <vector>
 
 #define GROUP_SIZE 64
 
 //For FLOPS calculation
 #define KERNEL_FLOPS 20
 
+// Steps in flight ahead of the displayed one, the extra slot is the one being drawn
+#define READBACK_DEPTH 2
+#define READBACK_SLOTS ( READBACK_DEPTH + 1 )
+
+// Initial conditions of the benchmark when --seed is not given, every run and every configuration of a sweep
+// starts from the same bodies
+#define BENCHMARK_SEED 1
+
+// Work-items of the first bounding box pass
+#define REDUCE_SIZE 256
+
+// Relative error of every particle's velocity the direct kernels must stay under in verifyResults, a kernel off by
+// 0.1% already fails
+#define VERIFY_TOLERANCE 1e-3
+
+// RMS of the relative error the tree must stay under in verifyResults, theta up to 0.9 stays under it
+#define TREE_TOLERANCE 0.05
+
 #define SAMPLE_VERSION "AMD-APP-SDK-v3.0.130.2"
 
 using namespace appsdk;
@@ -45,7 +66,9 @@ public:
    bool    isFirstLuanch;
    bool    listDetails;
    cl_event glEvent;
-   cl_bool display;
+   cl_bool display;                    // false with --no-display, Main then runs the benchmark instead of the window
+   std::string particleSweep;          // comma separated particle counts and work-group sizes the benchmark runs, one each by default
+   std::string groupSizeSweep;
 
    // calculate FPS
    double getFPS();
@@ -61,13 +84,44 @@ public:
    /**
    * Enqueue calls to the kernels
    * on to the command queue, wait till end of kernel execution.
-   * Get kernel start and end time if timing is enabled
+   * Get kernel start and end time if timing is enabled.
+   * Runs stepsPerReadback steps back to back, only the last one is read back
    * @return SDK_SUCCESS on success and SDK_FAILURE on failure
    */
    int runCLKernels();
 
-   float* getMappedParticlePositions();
-   void releaseMappedParticlePositions();
+   // With no readback there is nothing to acquire, runCLKernels only keeps the device busy
+   bool isReadbackEnabled() const { return stepsPerReadback > 0; }
+
+   /**
+   * Positions of the oldest step not yet consumed, valid until released.
+   * The pipelined readback waits on that step's transfer only, blocking
+   * maps the current position buffer
+   * @return nullptr on failure
+   */
+   const float* acquireParticlePositions();
+   void releaseParticlePositions();
+
+   // Steps to run ahead of the first acquire so the readbacks are in flight
+   int getPipelineDepth() const;
+
+   /**
+   * Runs the first step from rest and compares the new velocities with
+   * acceleration * dt from a direct sum in double, every particle within
+   * VERIFY_TOLERANCE relative error ( the tree within TREE_TOLERANCE RMS )
+   * @return SDK_SUCCESS on success and SDK_FAILURE on failure
+   */
+   int verifyResults();
+   bool isVerifyEnabled() const { return sampleArgs.verify; }
+
+   /**
+   * Headless run of benchmarkSteps steps after a warm-up one, prints the
+   * device time of every kernel from the profiling queue, the GFLOP/s and
+   * the interactions per second of the direct sum
+   * @return SDK_SUCCESS on success and SDK_FAILURE on failure
+   */
+   int runBenchmark();
+   void setGroupSize( size_t size ) { groupSize = size; }
 
    /**
    * Override from SDKSample
@@ -89,13 +143,42 @@ private:
    cl_mem particlePos[ 2 ]{};          // positions of particles
    cl_mem particleVel[ 2 ]{};          // velocity of particles
    int currentPosBufferIndex = 0;
-   float* mappedPosBuffer;             // mapped pointer of the position buffer
+   float* mappedPosBuffer;             // mapped pointer of the position buffer, or the acquired readback slot
    int mappedPosBufferIndex{};
    cl_command_queue commandQueue{};    /**< CL command queue */
+
+   // Every step's positions are copied into the next slot on a queue of their own, the host consumes the oldest
+   struct Readback
+   {
+      std::vector<cl_float> positions;
+      cl_event ready = nullptr;
+   };
+   std::string readbackMode{ "pipelined" }; /**< pipelined or blocking */
+   bool headless = false;              /**< --no-display, also creates the command queue with profiling enabled */
+   cl_uint benchmarkSteps = 100;
+   cl_uint seed = 0;                   // --seed of the initial conditions, 0 draws one unless headless
+   std::vector<std::pair<const char*, cl_event>> kernelEvents; // every kernel launch of a headless run, read once it is over
+   cl_uint stepsPerReadback = 1;       // steps enqueued back to back by runCLKernels, 0 never reads the positions back
+   cl_command_queue readbackQueue{};
+   Readback readbacks[ READBACK_SLOTS ];
+   int readbackHead = 0;               // slot of the next step
+   int readbacksPending = 0;           // including the acquired one
+   cl_event bufferRead[ 2 ]{};         // last readback of each position buffer, the step overwriting it waits on it
    cl_program program{};               /**< CL program */
-   cl_kernel kernel{};                 /**< CL kernel */
+   cl_kernel kernels[ 2 ]{};           // kernels[ i ] steps from buffer i into the other one, every argument is bound in setupCLKernels
+   std::string kernelType{ "simple" }; /**< simple ( nbody_sim ), tiled ( nbody_sim_tiled ) or tree */
    size_t groupSize;                   /**< Work-Group size */
 
+   // Barnes-Hut pipeline of NBody_Tree_Kernels.cl, in the order they run
+   enum TreeKernel { BOUNDING_BOX, BOUNDING_BOX_FINAL, MORTON_KEYS, BITONIC_SORT, BUILD_TREE, SUMMARIZE, TREE_FORCE, TREE_KERNELS };
+   enum TreeBuffer { PARTIAL_MIN, PARTIAL_MAX, BOX, MORTON_KEYS_BUFFER, SORTED_ORDER, CHILDREN, INTERNAL_PARENT, LEAF_PARENT, NODE_FLAGS,
+                     NODE_COM, NODE_MIN, NODE_MAX, TREE_BUFFERS };
+   static const char* const treeKernelNames[ TREE_KERNELS ];
+   cl_kernel treeKernels[ TREE_KERNELS ]{};
+   cl_mem treeBuffers[ TREE_BUFFERS ]{};
+   cl_uint paddedParticles = 0;        // numParticles rounded up to a power of two for the sort
+   cl_float theta = 0.5f;              /**< Opening angle of the tree */
+
    SDKDeviceInfo deviceInfo;           /**< Structure to store device information*/
    KernelWorkGroupInfo kernelInfo;     /**< Structure to store kernel related info */
 
@@ -134,6 +217,33 @@ private:
    * @return SDK_SUCCESS on success and SDK_FAILURE on failure
    */
    int setupCLKernels() const;
+
+   /**
+   * Tree kernels and their buffers, the arguments which do not change
+   * between frames and the pipeline for one step
+   * @return SDK_SUCCESS on success and SDK_FAILURE on failure
+   */
+   int setupTreeCL();
+   int setupTreeCLKernels() const;
+   int runTreeKernels( int currentBuffer, int nextBuffer );
+
+   /**
+   * Enqueues one step from the current position buffer into the other one
+   * and flips currentPosBufferIndex, nothing is flushed
+   * @return SDK_SUCCESS on success and SDK_FAILURE on failure
+   */
+   int enqueueStep();
+
+   // Where the launch of `name` stores its event when profiling, nullptr otherwise
+   cl_event* profileEvent( const char* name );
+   void releaseKernelEvents();
+
+   /**
+   * Copies the positions the last step wrote into the next readback slot
+   * once it completes, without blocking
+   * @return SDK_SUCCESS on success and SDK_FAILURE on failure
+   */
+   int enqueueReadback( int buffer );
 };
 
 #endif // NBODY_H_
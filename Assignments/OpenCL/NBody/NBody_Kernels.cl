@@ -85,3 +85,66 @@ void nbody_sim(__global float4* pos,
     newPosition[gid] = newPos;
     newVelocity[gid] = newVel;
 }
+
+/*
+ * Same integration as nbody_sim but the work-group cooperatively stages the
+ * positions into local memory one tile at a time, each work-item loads one
+ * position per tile so the global reads drop by the work-group size.
+ *
+ * localPos holds get_local_size(0) positions. A partial last tile is padded
+ * with massless bodies which add nothing to the acceleration.
+ */
+__kernel
+void nbody_sim_tiled(__global float4* pos,
+                     __global float4* vel,
+                     unsigned int numBodies ,float deltaTime, float epsSqr,
+                     __global float4* newPosition, __global float4* newVelocity,
+                     __local float4* localPos)
+{
+    unsigned int gid = get_global_id(0);
+    unsigned int lid = get_local_id(0);
+    unsigned int tileSize = get_local_size(0);
+
+    float4 myPos = pos[gid];
+    float4 acc = (float4)0.0f;
+
+    for (unsigned int tile = 0; tile < numBodies; tile += tileSize)
+    {
+        localPos[lid] = (tile + lid < numBodies) ? pos[tile + lid] : (float4)0.0f;
+        barrier(CLK_LOCAL_MEM_FENCE);
+
+#pragma unroll UNROLL_FACTOR
+        for (unsigned int j = 0; j < tileSize; j++)
+        {
+            float4 p = localPos[j];
+            float4 r;
+            r.xyz = p.xyz - myPos.xyz;
+            float distSqr = r.x * r.x  +  r.y * r.y  +  r.z * r.z;
+
+            float invDist = 1.0f / sqrt(distSqr + epsSqr);
+            float invDistCube = invDist * invDist * invDist;
+            float s = p.w * invDistCube;
+
+            // accumulate effect of all particles
+            acc.xyz += s * r.xyz;
+        }
+
+        // nobody may overwrite the tile while it is still being read
+        barrier(CLK_LOCAL_MEM_FENCE);
+    }
+
+    float4 oldVel = vel[gid];
+
+    // updated position and velocity
+    float4 newPos;
+    newPos.xyz = myPos.xyz + oldVel.xyz * deltaTime + acc.xyz * 0.5f * deltaTime * deltaTime;
+    newPos.w = myPos.w;
+
+    float4 newVel;
+    newVel.xyz = oldVel.xyz + acc.xyz * deltaTime;
+    newVel.w = oldVel.w;
+
+    // write to global memory
+    newPosition[gid] = newPos;
+    newVelocity[gid] = newVel;
+}
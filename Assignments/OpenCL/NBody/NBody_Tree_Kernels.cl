@@ -0,0 +1,383 @@
+/*
+MIT License
+
+Copyright (c) 2018 Chris McArthur, prince.chrismc(at)gmail(dot)com
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/*
+ * Barnes-Hut pipeline, one kernel per stage and no local memory so every stage
+ * also runs on CPU runtimes:
+ *
+ *  1. bounding_box / bounding_box_final reduce the bodies to a cube
+ *  2. morton_keys interleaves 21 bits per axis, bitonic_sort orders them
+ *  3. build_tree links the binary radix tree of the sorted keys ( Karras 2012 ),
+ *     a node whose prefix length is a multiple of 3 is an octree cell and the
+ *     nodes in between split a cell's children in pairs
+ *  4. summarize sums the masses, centers of mass and boxes from the leaves up
+ *  5. tree_force walks the tree with a private stack for every body
+ *
+ * Children >= 0 are internal nodes, a leaf is stored as ~j with j the body's
+ * position in the sorted order.
+ */
+
+#define MORTON_BITS 21
+
+/*
+ * Prefixes grow along every path from the root and are below 3 * MORTON_BITS
+ * for distinct keys or 64 + 32 with the index tie-break, the walk keeps one
+ * sibling per level so the stack never fills
+ */
+#define STACK_SIZE (3 * MORTON_BITS + 32 + 2)
+
+/* Each work-item reduces a strided slice of the bodies */
+__kernel
+void bounding_box(__global const float4* pos, unsigned int numBodies,
+                  __global float4* partialMin, __global float4* partialMax)
+{
+    unsigned int gid = get_global_id(0);
+    unsigned int stride = get_global_size(0);
+
+    float4 lo = pos[0];
+    float4 hi = pos[0];
+    for (unsigned int i = gid; i < numBodies; i += stride)
+    {
+        float4 p = pos[i];
+        lo.x = fmin(lo.x, p.x); lo.y = fmin(lo.y, p.y); lo.z = fmin(lo.z, p.z);
+        hi.x = fmax(hi.x, p.x); hi.y = fmax(hi.y, p.y); hi.z = fmax(hi.z, p.z);
+    }
+
+    partialMin[gid] = lo;
+    partialMax[gid] = hi;
+}
+
+/* A single work-item turns the partial boxes into a cube, box[0] is its corner and box[1].x its side */
+__kernel
+void bounding_box_final(__global const float4* partialMin, __global const float4* partialMax, unsigned int count,
+                        __global float4* box)
+{
+    if (get_global_id(0) != 0)
+        return;
+
+    float4 lo = partialMin[0];
+    float4 hi = partialMax[0];
+    for (unsigned int i = 1; i < count; i++)
+    {
+        lo.x = fmin(lo.x, partialMin[i].x); lo.y = fmin(lo.y, partialMin[i].y); lo.z = fmin(lo.z, partialMin[i].z);
+        hi.x = fmax(hi.x, partialMax[i].x); hi.y = fmax(hi.y, partialMax[i].y); hi.z = fmax(hi.z, partialMax[i].z);
+    }
+
+    float side = fmax(hi.x - lo.x, fmax(hi.y - lo.y, hi.z - lo.z));
+    float4 size = lo;
+    size.x = side > 0.0f ? side : 1.0f;
+
+    box[0] = lo;
+    box[1] = size;
+}
+
+ulong expand_bits(ulong v)
+{
+    v &= 0x1fffffUL;
+    v = (v | v << 32) & 0x1f00000000ffffUL;
+    v = (v | v << 16) & 0x1f0000ff0000ffUL;
+    v = (v | v << 8) & 0x100f00f00f00f00fUL;
+    v = (v | v << 4) & 0x10c30c30c30c30c3UL;
+    v = (v | v << 2) & 0x1249249249249249UL;
+    return v;
+}
+
+/* The keys are padded to a power of two for the sort, the padding sorts last */
+__kernel
+void morton_keys(__global const float4* pos, unsigned int numBodies, __global const float4* box,
+                 __global ulong* keys, __global unsigned int* order)
+{
+    unsigned int gid = get_global_id(0);
+    order[gid] = gid;
+    if (gid >= numBodies)
+    {
+        keys[gid] = ULONG_MAX;
+        return;
+    }
+
+    float4 lo = box[0];
+    float scale = (float)((1 << MORTON_BITS) - 1) / box[1].x;
+    float4 p = pos[gid];
+
+    ulong x = (ulong)clamp((p.x - lo.x) * scale, 0.0f, (float)((1 << MORTON_BITS) - 1));
+    ulong y = (ulong)clamp((p.y - lo.y) * scale, 0.0f, (float)((1 << MORTON_BITS) - 1));
+    ulong z = (ulong)clamp((p.z - lo.z) * scale, 0.0f, (float)((1 << MORTON_BITS) - 1));
+    keys[gid] = expand_bits(x) << 2 | expand_bits(y) << 1 | expand_bits(z);
+}
+
+/* One compare and exchange pass of the bitonic sort, the host runs every ( k, j ) pair */
+__kernel
+void bitonic_sort(__global ulong* keys, __global unsigned int* order, unsigned int j, unsigned int k)
+{
+    unsigned int i = get_global_id(0);
+    unsigned int partner = i ^ j;
+    if (partner <= i)
+        return;
+
+    ulong a = keys[i];
+    ulong b = keys[partner];
+    bool ascending = (i & k) == 0;
+    if ((a > b) == ascending)
+    {
+        keys[i] = b;
+        keys[partner] = a;
+
+        unsigned int swap = order[i];
+        order[i] = order[partner];
+        order[partner] = swap;
+    }
+}
+
+/* Length of the common prefix of two sorted keys, equal keys fall back on their positions */
+int common_prefix(__global const ulong* keys, int numBodies, int i, int j)
+{
+    if (j < 0 || j >= numBodies)
+        return -1;
+
+    ulong a = keys[i];
+    ulong b = keys[j];
+    if (a == b)
+        return 64 + (int)clz((uint)i ^ (uint)j);
+    return (int)clz(a ^ b);
+}
+
+/* Internal node i covers a range of sorted keys starting or ending at i, found by binary searches */
+__kernel
+void build_tree(__global const ulong* keys, unsigned int numBodies,
+                __global int* children, __global int* internalParent, __global int* leafParent, __global int* flags)
+{
+    int i = (int)get_global_id(0);
+    int n = (int)numBodies;
+    if (i >= n - 1)
+        return;
+
+    // direction of the range and an upper bound of its length
+    int d = common_prefix(keys, n, i, i + 1) - common_prefix(keys, n, i, i - 1) >= 0 ? 1 : -1;
+    int minPrefix = common_prefix(keys, n, i, i - d);
+    int maxLength = 2;
+    while (common_prefix(keys, n, i, i + maxLength * d) > minPrefix)
+        maxLength <<= 1;
+
+    // the other end
+    int length = 0;
+    for (int t = maxLength >> 1; t >= 1; t >>= 1)
+    {
+        if (common_prefix(keys, n, i, i + (length + t) * d) > minPrefix)
+            length += t;
+    }
+    int j = i + length * d;
+
+    // where the prefix grows by a bit
+    int nodePrefix = common_prefix(keys, n, i, j);
+    int split = 0;
+    int t = length;
+    do
+    {
+        t = (t + 1) >> 1;
+        if (common_prefix(keys, n, i, i + (split + t) * d) > nodePrefix)
+            split += t;
+    } while (t > 1);
+    int gamma = i + split * d + min(d, 0);
+
+    int first = min(i, j);
+    int last = max(i, j);
+    int left = first == gamma ? ~gamma : gamma;
+    int right = last == gamma + 1 ? ~(gamma + 1) : gamma + 1;
+
+    children[2 * i] = left;
+    children[2 * i + 1] = right;
+    if (left < 0) leafParent[~left] = i; else internalParent[left] = i;
+    if (right < 0) leafParent[~right] = i; else internalParent[right] = i;
+    if (i == 0) internalParent[0] = -1;
+
+    // for summarize
+    flags[i] = 0;
+}
+
+/*
+ * Every leaf climbs towards the root, the first of a node's two children to
+ * arrive stops and the second one sums the node so both are complete. The
+ * fences publish a node before its parent's counter is incremented.
+ */
+__kernel
+void summarize(__global const float4* pos, __global const unsigned int* order, unsigned int numBodies,
+               __global const int* children, __global const int* internalParent, __global const int* leafParent,
+               volatile __global int* flags,
+               volatile __global float4* nodeCom, volatile __global float4* nodeMin, volatile __global float4* nodeMax)
+{
+    unsigned int leaf = get_global_id(0);
+    if (leaf >= numBodies || numBodies < 2)
+        return;
+
+    int node = leafParent[leaf];
+    while (node >= 0)
+    {
+        mem_fence(CLK_GLOBAL_MEM_FENCE);
+        if (atomic_inc(&flags[node]) == 0)
+            return;
+        mem_fence(CLK_GLOBAL_MEM_FENCE);
+
+        float4 com = (float4)0.0f;
+        float4 lo;
+        float4 hi;
+        for (int c = 0; c < 2; c++)
+        {
+            int child = children[2 * node + c];
+            float4 childCom;
+            float4 childMin;
+            float4 childMax;
+            if (child < 0)
+            {
+                childCom = pos[order[~child]];
+                childMin = childCom;
+                childMax = childCom;
+            }
+            else
+            {
+                childCom = nodeCom[child];
+                childMin = nodeMin[child];
+                childMax = nodeMax[child];
+            }
+
+            com.x += childCom.x * childCom.w;
+            com.y += childCom.y * childCom.w;
+            com.z += childCom.z * childCom.w;
+            com.w += childCom.w;
+
+            if (c == 0)
+            {
+                lo = childMin;
+                hi = childMax;
+            }
+            else
+            {
+                lo.x = fmin(lo.x, childMin.x); lo.y = fmin(lo.y, childMin.y); lo.z = fmin(lo.z, childMin.z);
+                hi.x = fmax(hi.x, childMax.x); hi.y = fmax(hi.y, childMax.y); hi.z = fmax(hi.z, childMax.z);
+            }
+        }
+
+        // massless cells keep their geometric center
+        if (com.w > 0.0f)
+        {
+            com.x /= com.w; com.y /= com.w; com.z /= com.w;
+        }
+        else
+        {
+            com.x = 0.5f * (lo.x + hi.x); com.y = 0.5f * (lo.y + hi.y); com.z = 0.5f * (lo.z + hi.z);
+        }
+
+        // the largest side of the box is kept in w for the opening test
+        lo.w = fmax(hi.x - lo.x, fmax(hi.y - lo.y, hi.z - lo.z));
+        nodeCom[node] = com;
+        nodeMin[node] = lo;
+        nodeMax[node] = hi;
+
+        node = internalParent[node];
+    }
+}
+
+/*
+ * Same integration as nbody_sim with the acceleration from the tree. A node is
+ * accepted when its size / distance < theta unless the body is inside its box.
+ * Work-items take the bodies in sorted order so neighbours walk the same nodes.
+ */
+__kernel
+void tree_force(__global const float4* pos, __global const float4* vel, __global const unsigned int* order,
+                unsigned int numBodies, float deltaTime, float epsSqr, float thetaSqr,
+                __global const int* children, __global const float4* nodeCom, __global const float4* nodeMin,
+                __global const float4* nodeMax, __global float4* newPosition, __global float4* newVelocity)
+{
+    unsigned int sorted = get_global_id(0);
+    if (sorted >= numBodies)
+        return;
+
+    unsigned int body = order[sorted];
+    float4 myPos = pos[body];
+    float4 acc = (float4)0.0f;
+
+    int stack[STACK_SIZE];
+    int top = 0;
+    stack[top++] = numBodies > 1 ? 0 : ~0;
+
+    while (top > 0)
+    {
+        int node = stack[--top];
+
+        float4 p;
+        bool open = false;
+        if (node < 0)
+        {
+            p = pos[order[~node]];
+        }
+        else
+        {
+            p = nodeCom[node];
+            float dx = p.x - myPos.x;
+            float dy = p.y - myPos.y;
+            float dz = p.z - myPos.z;
+            float4 lo = nodeMin[node];
+            float4 hi = nodeMax[node];
+            bool inside = myPos.x >= lo.x && myPos.x <= hi.x && myPos.y >= lo.y && myPos.y <= hi.y && myPos.z >= lo.z && myPos.z <= hi.z;
+            open = (inside || lo.w * lo.w >= thetaSqr * (dx * dx + dy * dy + dz * dz));
+        }
+
+        if (open)
+        {
+            stack[top++] = children[2 * node];
+            stack[top++] = children[2 * node + 1];
+            continue;
+        }
+
+        float rx = p.x - myPos.x;
+        float ry = p.y - myPos.y;
+        float rz = p.z - myPos.z;
+        float distSqr = rx * rx + ry * ry + rz * rz;
+
+        float invDist = 1.0f / sqrt(distSqr + epsSqr);
+        float invDistCube = invDist * invDist * invDist;
+        float s = p.w * invDistCube;
+
+        // accumulate effect of the body or cell
+        acc.x += s * rx;
+        acc.y += s * ry;
+        acc.z += s * rz;
+    }
+
+    float4 oldVel = vel[body];
+
+    // updated position and velocity
+    float4 newPos = myPos;
+    newPos.x = myPos.x + oldVel.x * deltaTime + acc.x * 0.5f * deltaTime * deltaTime;
+    newPos.y = myPos.y + oldVel.y * deltaTime + acc.y * 0.5f * deltaTime * deltaTime;
+    newPos.z = myPos.z + oldVel.z * deltaTime + acc.z * 0.5f * deltaTime * deltaTime;
+
+    float4 newVel = oldVel;
+    newVel.x = oldVel.x + acc.x * deltaTime;
+    newVel.y = oldVel.y + acc.y * deltaTime;
+    newVel.z = oldVel.z + acc.z * deltaTime;
+
+    // write to global memory
+    newPosition[body] = newPos;
+    newVelocity[body] = newVel;
+}